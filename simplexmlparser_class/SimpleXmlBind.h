@@ -0,0 +1,349 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLBIND_H
+#define SIMPLEXMLBIND_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+
+#include "SimpleXmlParser.h"
+
+/*!
+ * @brief The field map of a struct filled by SimpleXmlBind, specialize it for each struct (see SXML_BINDING()).
+ *   Its static constexpr fields() returns a tuple of SimpleXmlBind::tag(), attribute() and list() entries.
+ */
+template <typename T>
+struct SimpleXmlBinding;
+
+/*!
+ * @brief Declares the field map of \a Type, at namespace scope:
+ *   SXML_BINDING(TestData,
+ *                SimpleXmlBind::tag("TestID", &TestData::testId),
+ *                SimpleXmlBind::list("Param", &TestData::params))
+ */
+#define SXML_BINDING(Type, ...) \
+    template <> \
+    struct SimpleXmlBinding<Type> \
+    { \
+        static constexpr auto fields() { return std::make_tuple(__VA_ARGS__); } \
+    };
+
+/*!
+ * @brief Fills structs from a message in a single pass, following the field maps declared with SXML_BINDING().
+ *   The markup is walked once: each child element is matched against the fields of the struct it belongs to
+ *   and goes straight into its member, a bound struct member or list item is filled recursively and the
+ *   elements not mapped are jumped over. The map is a constexpr tuple, so the lookup and the conversion of
+ *   every field are resolved at compile time.
+ *   A member can be a QString (entities decoded), int, uint, qint64, quint64, double, bool (converted as
+ *   SimpleXmlParser::parseValue() does, a value that does not convert leaves the member untouched) or a
+ *   struct with a binding of its own. A list is any container of those with push_back() and back().
+ *   The names in the map are compared with the tag and attribute names as ASCII.
+ */
+class SimpleXmlBind
+{
+public:
+    template <typename Owner, typename Member>
+    struct TagField
+    {
+        const char *name;
+        Member Owner::*member;
+    };
+
+    template <typename Owner, typename Member>
+    struct AttributeField
+    {
+        const char *name;
+        Member Owner::*member;
+    };
+
+    template <typename Owner, typename List>
+    struct ListField
+    {
+        const char *container;      //the element wrapping the items, 0 if they are children of the struct element
+        const char *name;
+        List Owner::*member;
+    };
+
+    /* the child element \a name goes into \a member */
+    template <typename Owner, typename Member>
+    static constexpr TagField<Owner, Member> tag(const char *name, Member Owner::*member)
+    {
+        return TagField<Owner, Member>{ name, member };
+    }
+
+    /* the attribute \a name of the struct element goes into \a member */
+    template <typename Owner, typename Member>
+    static constexpr AttributeField<Owner, Member> attribute(const char *name, Member Owner::*member)
+    {
+        return AttributeField<Owner, Member>{ name, member };
+    }
+
+    /* every child element \a name is appended to \a member */
+    template <typename Owner, typename List>
+    static constexpr ListField<Owner, List> list(const char *name, List Owner::*member)
+    {
+        return ListField<Owner, List>{ 0, name, member };
+    }
+
+    /* every element \a name inside the child element \a container is appended to \a member */
+    template <typename Owner, typename List>
+    static constexpr ListField<Owner, List> list(const char *container, const char *name, List Owner::*member)
+    {
+        return ListField<Owner, List>{ container, name, member };
+    }
+
+    /*!
+     * @brief Fills \a out from the first element found in \a msg from \a beginidx, the root element by default.
+     * @return false if there is no element or the message ends before the element does
+     */
+    template <typename T>
+    static bool fill(const QString &msg, T &out, int beginidx=0)
+    {
+        SimpleXmlParser::Markup markup;
+        int pos = beginidx;
+        while (SimpleXmlParser::nextMarkup(msg.constData(), msg.size(), pos, markup)) {
+            if (markup.kind == SimpleXmlParser::Markup::E_StartTag || markup.kind == SimpleXmlParser::Markup::E_EmptyElementTag)
+                return fillValue(msg.constData(), msg.size(), markup, out, pos);
+            pos = markup.end;
+        }
+        return false;
+    }
+
+    /*!
+     * @brief Fills a T from each element \a name of \a msg, at any depth, in one pass.
+     */
+    template <typename T>
+    static QVector<T> fillAll(const QString &msg, const char *name)
+    {
+        QVector<T> all;
+        const QChar *data = msg.constData();
+        SimpleXmlParser::Markup markup;
+        int pos = 0;
+        while (SimpleXmlParser::nextMarkup(data, msg.size(), pos, markup)) {
+            if (markup.kind != SimpleXmlParser::Markup::E_EndTag && markup.kind != SimpleXmlParser::Markup::E_OtherMarkup
+                    && nameIs(data, markup, name)) {
+                all.push_back(T());
+                if (!fillValue(data, msg.size(), markup, all.back(), pos))
+                    break;
+                continue;
+            }
+            pos = markup.end;
+        }
+        return all;
+    }
+
+private:
+    typedef SimpleXmlParser::Markup Markup;
+
+    template <typename T, typename = void>
+    struct IsBound : std::false_type {};
+
+    template <typename T>
+    struct IsBound<T, std::void_t<decltype(SimpleXmlBinding<T>::fields())> > : std::true_type {};
+
+    template <typename T>
+    struct IsScalar : std::integral_constant<bool, std::is_same<T, QString>::value || std::is_same<T, int>::value
+                                                   || std::is_same<T, uint>::value || std::is_same<T, qint64>::value
+                                                   || std::is_same<T, quint64>::value || std::is_same<T, double>::value
+                                                   || std::is_same<T, bool>::value> {};
+
+    static bool nameIs(const QChar *name, int length, const char *expected)
+    {
+        for (int i = 0; i < length; i++) {
+            if (expected[i] == 0 || name[i].unicode() != ushort(uchar(expected[i])))
+                return false;
+        }
+        return expected[length] == 0;
+    }
+
+    static bool nameIs(const QChar *data, const Markup &markup, const char *expected)
+    {
+        return nameIs(data + markup.nameBegin, markup.nameEnd - markup.nameBegin, expected);
+    }
+
+    /* the field of the tuple the function gives a non zero result for, from the first one */
+    template <size_t I = 0, typename Tuple, typename Function>
+    static int firstMatch(const Tuple &fields, Function &&function)
+    {
+        if constexpr (I < std::tuple_size<Tuple>::value) {
+            int r = function(std::get<I>(fields));
+            return r != 0 ? r : firstMatch<I + 1>(fields, function);
+        }
+        else {
+            return 0;
+        }
+    }
+
+    static void convert(QStringView text, QString &value)
+    {
+        value = SimpleXmlParser::decodeEntities(text.toString());
+    }
+
+    template <typename T>
+    static void convert(QStringView text, T &value)
+    {
+        SimpleXmlParser::parseValue(text, value);
+    }
+
+    /* moves pos past the element started by start, contentEnd is where its end tag begins */
+    static bool elementEnd(const QChar *data, int size, const Markup &start, int &contentEnd, int &pos)
+    {
+        pos = start.end;
+        contentEnd = start.end;
+        if (start.kind == Markup::E_EmptyElementTag)
+            return true;
+
+        int depth = 1;
+        Markup markup;
+        while (SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+            pos = markup.end;
+            if (markup.kind == Markup::E_StartTag) {
+                depth++;
+            }
+            else if (markup.kind == Markup::E_EndTag && --depth == 0) {
+                contentEnd = markup.begin;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* fills value from the element started by start, a struct field by field or a scalar from the content */
+    template <typename T>
+    static bool fillValue(const QChar *data, int size, const Markup &start, T &value, int &pos)
+    {
+        static_assert(IsBound<T>::value || IsScalar<T>::value, "SimpleXmlBind: the member type has no binding and is not a supported scalar");
+        if constexpr (IsBound<T>::value) {
+            return fillStruct(data, size, start, value, pos);
+        }
+        else {
+            int contentEnd;
+            if (!elementEnd(data, size, start, contentEnd, pos))
+                return false;
+            convert(QStringView(data + start.end, contentEnd - start.end), value);
+            return true;
+        }
+    }
+
+    template <typename T>
+    static bool fillStruct(const QChar *data, int size, const Markup &start, T &out, int &pos)
+    {
+        constexpr auto fields = SimpleXmlBinding<T>::fields();
+
+        SimpleXmlParser::AttributeIterator it(data + start.nameEnd, data + start.attributesEnd);
+        while (it.hasNext()) {
+            SimpleXmlParser::Attribute attr = it.next();
+            firstMatch(fields, [&attr, &out](const auto &field) { return fillAttribute(field, attr, out); });
+        }
+
+        pos = start.end;
+        if (start.kind == Markup::E_EmptyElementTag)
+            return true;
+
+        Markup markup;
+        while (SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+            if (markup.kind == Markup::E_EndTag) {
+                pos = markup.end;
+                return true;
+            }
+            if (markup.kind == Markup::E_OtherMarkup) {
+                pos = markup.end;
+                continue;
+            }
+            int r = firstMatch(fields, [data, size, &markup, &out, &pos](const auto &field) {
+                return fillChild(field, data, size, markup, out, pos);
+            });
+            int contentEnd;
+            if (r < 0 || (r == 0 && !elementEnd(data, size, markup, contentEnd, pos)))
+                return false;
+        }
+        return false;
+    }
+
+    /* the items named name inside the container element started by start */
+    template <typename List>
+    static bool fillList(const QChar *data, int size, const Markup &start, const char *name, List &list, int &pos)
+    {
+        pos = start.end;
+        if (start.kind == Markup::E_EmptyElementTag)
+            return true;
+
+        Markup markup;
+        while (SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+            if (markup.kind == Markup::E_EndTag) {
+                pos = markup.end;
+                return true;
+            }
+            if (markup.kind == Markup::E_OtherMarkup) {
+                pos = markup.end;
+                continue;
+            }
+            int contentEnd;
+            if (nameIs(data, markup, name)) {
+                list.push_back(typename List::value_type());
+                if (!fillValue(data, size, markup, list.back(), pos))
+                    return false;
+            }
+            else if (!elementEnd(data, size, markup, contentEnd, pos)) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /* 1 if the child element was filled into its field, 0 if it is not the one of the field, -1 on a truncated message */
+    template <typename Owner, typename Member>
+    static int fillChild(const TagField<Owner, Member> &field, const QChar *data, int size, const Markup &markup, Owner &out, int &pos)
+    {
+        if (!nameIs(data, markup, field.name))
+            return 0;
+        return fillValue(data, size, markup, out.*field.member, pos) ? 1 : -1;
+    }
+
+    template <typename Owner, typename List>
+    static int fillChild(const ListField<Owner, List> &field, const QChar *data, int size, const Markup &markup, Owner &out, int &pos)
+    {
+        List &list = out.*field.member;
+        if (field.container) {
+            if (!nameIs(data, markup, field.container))
+                return 0;
+            return fillList(data, size, markup, field.name, list, pos) ? 1 : -1;
+        }
+        if (!nameIs(data, markup, field.name))
+            return 0;
+        list.push_back(typename List::value_type());
+        return fillValue(data, size, markup, list.back(), pos) ? 1 : -1;
+    }
+
+    template <typename Owner, typename Member>
+    static int fillChild(const AttributeField<Owner, Member> &, const QChar *, int, const Markup &, Owner &, int &)
+    {
+        return 0;
+    }
+
+    template <typename Owner, typename Member>
+    static int fillAttribute(const AttributeField<Owner, Member> &field, const SimpleXmlParser::Attribute &attr, Owner &out)
+    {
+        if (!nameIs(attr.name.data(), int(attr.name.size()), field.name))
+            return 0;
+        convert(attr.value, out.*field.member);
+        return 1;
+    }
+
+    template <typename Field, typename Owner>
+    static int fillAttribute(const Field &, const SimpleXmlParser::Attribute &, Owner &)
+    {
+        return 0;
+    }
+};
+
+#endif // SIMPLEXMLBIND_H
@@ -0,0 +1,516 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLCORE_H
+#define SIMPLEXMLCORE_H
+
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "SimpleXmlScan.h"
+
+/*!
+ * @brief The framing engine of SimpleXmlParser without Qt: no QObject, no signals, no Qt containers.
+ *   It cuts the messages enclosed in any of its start tags out of a stream fed in chunks of any size
+ *   and recognizes the tags to find inside them while they arrive. Char is char16_t for UTF-16 text
+ *   or char for UTF-8 (the tag names must then be given in UTF-8 too).
+ *
+ *   The events are delivered to the handler passed to feed() while the chunk is scanned, it must
+ *   provide these three members (a message comes after the tags found in it):
+ *     void message(int startTag, View msg);    //a complete message enclosed in the start tag with that index
+ *     void tag(int tag, View value);           //the raw value of the tag to find with index tag
+ *     void unmatchedEndTag();                  //an end tag without its start tag, a chunk was probably lost
+ *   The views point into the buffer and are valid only during the call, the handler must not feed
+ *   the same core again from there.
+ */
+template <typename Char>
+class SimpleXmlCore
+{
+public:
+    typedef std::basic_string<Char> String;
+    typedef std::basic_string_view<Char> View;
+
+    SimpleXmlCore()
+        : m_lastTagPos(0),
+          m_msgStartPos(-1),
+          m_msgStartTag(-1),
+          m_skipping(false),
+          m_skipped(0),
+          m_reserved(0)
+    {
+    }
+
+    /*!
+     * @brief Makes \a name the only tag enclosing the messages and restarts framing from the beginning of the buffer.
+     */
+    void setStartTag(View name)
+    {
+        m_startTrie.clear();
+        m_startTags.clear();
+        m_endPatterns.clear();
+        addStartTag(name);
+        resetFraming();
+    }
+
+    /*!
+     * @brief Adds a tag enclosing messages, all the start tags are looked for at once while scanning.
+     *   A start tag may carry attributes and an empty element tag (<name/>) is a message by itself.
+     *   A message ends at the first end tag of its own start tag, the other start tags are just text inside it.
+     * @return the index passed to the handler with the messages of this tag, -1 if the name is empty
+     */
+    int addStartTag(View name)
+    {
+        if (name.empty())
+            return -1;
+
+        int tag = trieAdd(m_startTrie, name, int(m_startTags.size()));
+        if (tag == int(m_startTags.size())) {
+            m_startTags.push_back(String(name));
+            m_endPatterns.push_back(String());
+            m_endPatterns.back().append(1, Char('<')).append(1, Char('/')).append(name).append(1, Char('>'));
+        }
+        return tag;
+    }
+
+    /*!
+     * @brief Registers a tag whose values are reported to the handler, the name goes without angular brackets.
+     * @return the index passed to the handler for this tag, -1 if the name is empty
+     */
+    int addTagToFind(View name)
+    {
+        if (name.empty())
+            return -1;
+
+        int tag = trieAdd(m_trie, name, int(m_tagNames.size()));
+        if (tag == int(m_tagNames.size()))
+            m_tagNames.push_back(String(name));
+        return tag;
+    }
+
+    int startTagCount() const                                   { return int(m_startTags.size());   }
+    View startTagName(int startTag) const                       { return m_startTags.at(startTag);  }
+    int tagCount() const                                        { return int(m_tagNames.size());    }
+    View tagName(int tag) const                                 { return m_tagNames.at(tag);        }
+    View buffer() const                                         { return m_buffer;                  }
+    int bufferSize() const                                      { return int(m_buffer.size());      }
+    bool isSkipping() const                                     { return m_skipping;                }
+    bool isInMessage() const                                    { return m_msgStartPos >= 0;        }
+    long long skippedCount() const                              { return m_skipped;                 }
+
+    void clear()
+    {
+        m_buffer.clear();
+        resetFraming();
+    }
+
+    /*!
+     * @brief Forgets where the last scan stopped, the next feed() scans the buffer from its beginning.
+     */
+    void resetFraming()
+    {
+        m_lastTagPos = 0;
+        m_msgStartPos = -1;
+        m_msgStartTag = -1;
+        m_skipping = false;
+        m_openTags.clear();
+    }
+
+    /*!
+     * @brief Drops the buffer with the message being framed and skips the data that follows up to the next start tag.
+     *   Meant for a message that outgrew the memory allowed to it: what is skipped is added to skippedCount()
+     *   and the end tag of the message dropped is not reported as unmatched. After a frameExternal() that
+     *   consumed nothing, \a externalSize is the size of the data it was given, which is skipped as well.
+     */
+    void skipMessage(int externalSize=0)
+    {
+        m_skipped += (long long)m_buffer.size() + externalSize;
+        m_buffer.clear();
+        resetFraming();
+        m_skipping = true;
+    }
+
+    /*!
+     * @brief The part of the message in progress already scanned, from its start tag. It can be saved elsewhere
+     *   and taken out of the buffer with dropMessageHead(). Empty if no message is in progress.
+     */
+    View messageHead() const
+    {
+        if (m_msgStartPos < 0)
+            return View();
+        return View(m_buffer.data() + m_msgStartPos, size_t(m_lastTagPos - m_msgStartPos));
+    }
+
+    /*!
+     * @brief Takes the first \a size characters of messageHead() out of the buffer, the framing goes on with the rest.
+     *   The message is then reported without them and the tags to find opened in them are not reported.
+     */
+    void dropMessageHead(int size)
+    {
+        m_buffer.erase(size_t(m_msgStartPos), size_t(size));
+        m_lastTagPos -= size;
+        size_t kept = 0;
+        for (size_t i = 0; i < m_openTags.size(); i++) {
+            if (m_openTags[i].contentBegin >= m_msgStartPos + size) {
+                m_openTags[kept] = m_openTags[i];
+                m_openTags[kept].contentBegin -= size;
+                kept++;
+            }
+        }
+        m_openTags.resize(kept);
+    }
+
+    /*!
+     * @brief Appends \a size characters to the buffer and reports to \a handler what they complete.
+     */
+    template <typename Handler>
+    void feed(const Char *data, int size, Handler &&handler)
+    {
+        append(data, size);
+        frame(handler);
+    }
+
+    /*!
+     * @brief Appends \a size characters to the buffer, they are scanned by the next frame().
+     */
+    void append(const Char *data, int size)
+    {
+        m_buffer.append(data, size_t(size));
+    }
+
+    /*!
+     * @brief Makes room for \a size characters at the end of the buffer, to be filled in place (e.g. by a read).
+     *   It must be followed by commit() before anything else is done with the core. The buffer keeps its
+     *   capacity when the consumed data is dropped, so once grown it is reused read after read.
+     */
+    Char *reserve(int size)
+    {
+        m_reserved = m_buffer.size();
+        m_buffer.resize(m_reserved + size_t(size));
+        return &m_buffer[m_reserved];
+    }
+
+    /*!
+     * @brief Keeps the first \a written characters of the room made by reserve() and drops the rest.
+     */
+    void commit(int written)
+    {
+        m_buffer.resize(m_reserved + size_t(written));
+    }
+
+    /*!
+     * @brief Scans what was appended since the last scan and reports to \a handler what it completes.
+     *   The scan restarts where the previous one stopped so every character is looked at once no
+     *   matter how the stream is chunked, and the consumed part of the buffer is dropped once per call.
+     */
+    template <typename Handler>
+    void frame(Handler &&handler)
+    {
+        int consumed = scan(m_buffer.data(), int(m_buffer.size()), handler);
+        if (consumed > 0)
+            m_buffer.erase(0, size_t(consumed));
+    }
+
+    /*!
+     * @brief Frames \a size characters that stay where they are (e.g. a memory mapped file) instead of the buffer.
+     *   The reported views point into \a data. The first characters up to the returned count are done with,
+     *   the rest is an unfinished message or tag: the next call must pass the data again starting from
+     *   there, followed by what comes next. The buffer must be empty and is not touched.
+     * @return how many characters at the beginning of \a data are no longer needed
+     */
+    template <typename Handler>
+    int frameExternal(const Char *data, int size, Handler &&handler)
+    {
+        return scan(data, size, handler);
+    }
+
+    /*!
+     * @brief Finds the '>' closing a tag from \a from, quoted attribute values are jumped over.
+     * @return the index of the '>', -1 if the tag is not complete, -2 if a '<' comes first: the tag is
+     *   malformed (e.g. an unterminated quote, a '<' can not appear in an attribute value) and never closes
+     */
+    static int findTagClose(const char16_t *data, int size, int from)
+    {
+        static const char16_t delimiters[] = { u'>', u'"', u'\'', u'<' };
+        int n = from;
+        while (true) {
+            n = SimpleXmlScan::findFirstOf(data, size, n, delimiters, 4);
+            if (n < 0 || data[n] == u'>')
+                return n;
+            if (data[n] == u'<')
+                return -2;
+            const char16_t quoteEnd[] = { data[n], u'<' };
+            n = SimpleXmlScan::findFirstOf(data, size, n + 1, quoteEnd, 2);
+            if (n < 0)
+                return -1;
+            if (data[n] == u'<')
+                return -2;
+            n++;
+        }
+    }
+
+    static int findTagClose(const char *data, int size, int from)
+    {
+        char quote = 0;
+        for (int n = from; n < size; n++) {
+            char c = data[n];
+            if (c == '<')
+                return -2;
+            if (quote) {
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '>') {
+                return n;
+            }
+            else if (c == '"' || c == '\'') {
+                quote = c;
+            }
+        }
+        return -1;
+    }
+
+private:
+    enum MatchResult { E_Mismatch, E_Match, E_Incomplete };
+
+    /* tag names in a trie, walked one character at a time from the '<' */
+    struct TrieNode
+    {
+        std::vector<std::pair<Char, int> > children;    //character, index of the child node
+        int tag;                                        //index of the name ending here, -1 if none
+
+        TrieNode() : tag(-1)                                    {}
+    };
+
+    /* a tag to find whose end tag was not found yet, the offset is in the data being framed */
+    struct OpenTag
+    {
+        int tag;
+        int contentBegin;
+    };
+
+    String m_buffer;
+    int m_lastTagPos;   //offset where the next scan resumes
+    int m_msgStartPos;  //offset of the message being framed, -1 if none
+    int m_msgStartTag;  //index of the start tag of the message being framed
+    bool m_skipping;    //set by skipMessage() until the next start tag
+    long long m_skipped;
+    size_t m_reserved;  //buffer offset of the room made by reserve()
+    std::vector<TrieNode> m_startTrie;
+    std::vector<String> m_startTags;
+    std::vector<String> m_endPatterns;  //"</name>" for each start tag
+    std::vector<TrieNode> m_trie;       //the tags to find
+    std::vector<String> m_tagNames;
+    std::vector<OpenTag> m_openTags;
+
+    static bool isSpace(Char c)
+    {
+        return c == Char(' ') || c == Char('\t') || c == Char('\n') || c == Char('\r');
+    }
+
+    static int findUnit(const char16_t *data, int size, int from, char16_t c)
+    {
+        return SimpleXmlScan::indexOf(data, size, from, c);
+    }
+
+    static int findUnit(const char *data, int size, int from, char c)
+    {
+        if (from >= size)
+            return -1;
+        const void *found = memchr(data + from, c, size_t(size - from));
+        return found ? int(static_cast<const char *>(found) - data) : -1;
+    }
+
+    /* frames buf from where the previous scan stopped, the offsets kept are rebased past the consumed part */
+    template <typename Handler>
+    int scan(const Char *buf, int bufSize, Handler &handler)
+    {
+        if (m_startTags.empty())
+            return 0;
+
+        int pos = m_lastTagPos;
+        while ((pos = findUnit(buf, bufSize, pos, Char('<'))) >= 0) {
+            MatchResult r;
+            int tag, tagEnd;
+            bool endTag;
+            if (m_msgStartPos < 0) {
+                //any of the start tags, or the end tag of one of them if its start tag was lost
+                r = matchTag(m_startTrie, buf, bufSize, pos, tag, endTag, tagEnd);
+                if (r == E_Incomplete) {
+                    break;  //a tag might be split across chunks, resume from here when more data arrives
+                }
+                if (r == E_Match) {
+                    if (endTag) {
+                        if (!m_skipping)
+                            handler.unmatchedEndTag();
+                        pos = tagEnd;
+                        continue;
+                    }
+                    if (m_skipping) {
+                        m_skipped += pos;
+                        m_skipping = false;
+                    }
+                    if (buf[tagEnd - 2] == Char('/')) {
+                        handler.message(tag, View(buf + pos, size_t(tagEnd - pos)));
+                    }
+                    else {
+                        m_msgStartPos = pos;
+                        m_msgStartTag = tag;
+                    }
+                    pos = tagEnd;
+                    continue;
+                }
+                pos++;
+                continue;
+            }
+
+            const String &endPattern = m_endPatterns[size_t(m_msgStartTag)];
+            r = matchAt(buf, bufSize, pos, endPattern);
+            if (r == E_Incomplete) {
+                break;
+            }
+            if (r == E_Match) {
+                int msgEnd = pos + int(endPattern.size());
+                handler.message(m_msgStartTag, View(buf + m_msgStartPos, size_t(msgEnd - m_msgStartPos)));
+                m_msgStartPos = -1;
+                m_openTags.clear();     //tags left open are not reported
+                pos = msgEnd;
+                continue;
+            }
+            if (!m_trie.empty()) {
+                r = matchTag(m_trie, buf, bufSize, pos, tag, endTag, tagEnd);
+                if (r == E_Incomplete) {
+                    //the tag goes on in the next chunk, unless the message is already over and the tag is just malformed
+                    if (View(buf, size_t(bufSize)).find(endPattern, size_t(pos)) == View::npos)
+                        break;
+                    r = E_Mismatch;
+                }
+                if (r == E_Match) {
+                    if (endTag) {
+                        int i = int(m_openTags.size()) - 1;
+                        while (i >= 0 && m_openTags[i].tag != tag)
+                            i--;
+                        if (i >= 0) {
+                            int contentBegin = m_openTags[i].contentBegin;
+                            m_openTags.resize(size_t(i));
+                            handler.tag(tag, View(buf + contentBegin, size_t(pos - contentBegin)));
+                        }
+                    }
+                    else if (buf[tagEnd - 2] == Char('/')) {
+                        handler.tag(tag, View(buf + tagEnd, 0));   //empty element tag
+                    }
+                    else {
+                        OpenTag open = { tag, tagEnd };
+                        m_openTags.push_back(open);
+                    }
+                    pos = tagEnd;
+                    continue;
+                }
+            }
+            pos++;
+        }
+
+        if (pos < 0) {
+            pos = bufSize;
+        }
+
+        //when no message is in progress nothing before the resume point can be part of a future message
+        int consumed = m_msgStartPos >= 0 ? m_msgStartPos : pos;
+        if (m_skipping)
+            m_skipped += consumed;
+        if (consumed > 0) {
+            if (m_msgStartPos >= 0)
+                m_msgStartPos -= consumed;
+            for (size_t i = 0; i < m_openTags.size(); i++)
+                m_openTags[i].contentBegin -= consumed;
+            pos -= consumed;
+        }
+        m_lastTagPos = pos;
+        return consumed;
+    }
+
+    /* adds name to trie with the index newTag unless it is already there, returns the index of the name */
+    static int trieAdd(std::vector<TrieNode> &trie, View name, int newTag)
+    {
+        if (trie.empty())
+            trie.push_back(TrieNode());
+
+        int node = 0;
+        for (size_t i = 0; i < name.size(); i++) {
+            int next = trieChild(trie, node, name[i]);
+            if (next < 0) {
+                next = int(trie.size());
+                trie.push_back(TrieNode());
+                trie[node].children.push_back(std::make_pair(name[i], next));
+            }
+            node = next;
+        }
+        if (trie[node].tag < 0)
+            trie[node].tag = newTag;
+        return trie[node].tag;
+    }
+
+    static int trieChild(const std::vector<TrieNode> &trie, int node, Char c)
+    {
+        const std::vector<std::pair<Char, int> > &children = trie[node].children;
+        for (size_t i = 0; i < children.size(); i++) {
+            if (children[i].first == c)
+                return children[i].second;
+        }
+        return -1;
+    }
+
+    /* E_Incomplete if the buffer ends before the comparison could be decided (the tag may be split across chunks) */
+    static MatchResult matchAt(const Char *data, int size, int pos, const String &pattern)
+    {
+        size_t available = size_t(size - pos);
+        size_t len = pattern.size();
+        if (available < len)
+            return memcmp(data + pos, pattern.data(), available * sizeof(Char)) == 0 ? E_Incomplete : E_Mismatch;
+        return memcmp(data + pos, pattern.data(), len * sizeof(Char)) == 0 ? E_Match : E_Mismatch;
+    }
+
+    /* whether the tag at pos (a '<') is the start or end tag of a name in trie, tagEnd is just past its '>' */
+    static MatchResult matchTag(const std::vector<TrieNode> &trie, const Char *data, int size, int pos, int &tag, bool &endTag, int &tagEnd)
+    {
+        int p = pos + 1;
+        if (p >= size)
+            return E_Incomplete;
+        endTag = (data[p] == Char('/'));
+        if (endTag)
+            p++;
+
+        int node = 0;
+        for (; p < size; p++) {
+            Char c = data[p];
+            if (c == Char('>') || c == Char('/') || isSpace(c))
+                break;
+            node = trieChild(trie, node, c);
+            if (node < 0)
+                return E_Mismatch;
+        }
+        if (p >= size)
+            return E_Incomplete;
+        tag = trie[node].tag;
+        if (tag < 0)
+            return E_Mismatch;
+
+        int close = findTagClose(data, size, p);
+        if (close == -2)
+            return E_Mismatch;      //never closes, framing goes on from the '<' that follows
+        if (close < 0)
+            return E_Incomplete;    //the tag goes on in the next chunk
+        tagEnd = close + 1;
+        return E_Match;
+    }
+};
+
+typedef SimpleXmlCore<char16_t> SimpleXmlCore16;
+typedef SimpleXmlCore<char> SimpleXmlCoreUtf8;
+
+#endif // SIMPLEXMLCORE_H
@@ -0,0 +1,386 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):                                                                 *
+ *              Francesco Lamonica		<f.lamonica@netresults.it>              *
+ ********************************************************************************/
+
+#include "SimpleXmlIndex.h"
+
+#include <QDebug>
+#include <QStringList>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <string.h>
+
+/*!
+   \class SimpleXmlIndex
+   \brief a message parsed in a single pass into a flat array of element records (a very lightweight DOM)
+   \note elements are stored in document order so the first record is the root element
+  */
+SimpleXmlIndex::SimpleXmlIndex()
+{
+}
+
+
+
+SimpleXmlIndex::SimpleXmlIndex(const QString &msg)
+{
+    build(msg);
+}
+
+
+
+void
+SimpleXmlIndex::clear()
+{
+    m_msg.clear();
+    m_elements.clear();
+}
+
+
+
+/*
+ *  turns the markup of a message, given in document order, into the element records
+ */
+struct SimpleXmlIndex::Builder
+{
+    SimpleXmlIndex &index;
+    QVarLengthArray<int, 32> open;          //the elements whose end tag was not found yet
+    QVarLengthArray<int, 32> lastChild;     //the last child found for each open element
+    int lastTopLevel;
+    bool wellFormed;
+
+    explicit Builder(SimpleXmlIndex &i) : index(i), lastTopLevel(-1), wellFormed(true)   {}
+
+    void add(const SimpleXmlParser::Markup &markup)
+    {
+        QVector<Element> &elements = index.m_elements;
+
+        if (markup.kind == SimpleXmlParser::Markup::E_StartTag || markup.kind == SimpleXmlParser::Markup::E_EmptyElementTag) {
+            Element el;
+            el.nameBegin = markup.nameBegin;
+            el.nameLength = markup.nameEnd - markup.nameBegin;
+            el.attributesBegin = markup.nameEnd;
+            el.attributesLength = markup.attributesEnd - markup.nameEnd;
+            el.contentBegin = markup.end;
+            el.contentLength = 0;
+            el.parent = open.isEmpty() ? -1 : open.last();
+            el.firstChild = -1;
+            el.nextSibling = -1;
+            el.depth = open.size();
+
+            int idx = elements.size();
+            int &previous = open.isEmpty() ? lastTopLevel : lastChild.last();
+            if (previous >= 0)
+                elements[previous].nextSibling = idx;
+            else if (el.parent >= 0)
+                elements[el.parent].firstChild = idx;
+            previous = idx;
+            elements.append(el);
+
+            if (markup.kind == SimpleXmlParser::Markup::E_StartTag) {
+                open.append(idx);
+                lastChild.append(-1);
+            }
+        }
+        else if (markup.kind == SimpleXmlParser::Markup::E_EndTag) {
+            QStringView name(index.m_msg.constData() + markup.nameBegin, markup.nameEnd - markup.nameBegin);
+            int i = open.size() - 1;
+            while (i >= 0 && !index.nameIs(open[i], name))
+                i--;
+            if (i < 0) {
+                wellFormed = false;     //stray end tag, ignore it
+                return;
+            }
+            if (i != open.size() - 1)
+                wellFormed = false;
+            for (int j = open.size() - 1; j >= i; j--) {
+                Element &el = elements[open[j]];
+                el.contentLength = markup.begin - el.contentBegin;
+            }
+            open.resize(i);
+            lastChild.resize(i);
+        }
+    }
+
+    bool finish()
+    {
+        //elements left open extend up to the end of the message
+        for (int j = 0; j < open.size(); j++) {
+            Element &el = index.m_elements[open[j]];
+            el.contentLength = index.m_msg.size() - el.contentBegin;
+            wellFormed = false;
+        }
+
+#ifdef SXML_DBG
+        qDebug() << "SXML - indexed" << index.m_elements.size() << "elements, well formed:" << wellFormed;
+#endif
+
+        return wellFormed;
+    }
+};
+
+
+
+/*!
+  \brief indexes all the elements of \a msg
+  Comments, CDATA sections and processing instructions are skipped, an end tag closes the innermost
+  open element with the same name (and any element left open inside it).
+  \return false if the message is not well formed (unbalanced tags or truncated markup), the elements
+  found are indexed anyway
+  */
+bool
+SimpleXmlIndex::build(const QString &msg)
+{
+    m_msg = msg;
+    m_elements.clear();
+
+    const QChar *data = m_msg.constData();
+    const int size = m_msg.size();
+
+    Builder builder(*this);
+    SimpleXmlParser::Markup markup;
+    int pos = 0;
+    while (SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+        pos = markup.end;
+        builder.add(markup);
+    }
+    return builder.finish();
+}
+
+
+
+/*!
+  \brief the same as build() with the message split in chunks scanned by up to \a threads threads
+  (0 for one per core), meant for very large messages. The index is identical to the one of build().
+  Each thread finds the markup from the first '<' of its chunk on, guessing it is not inside a comment or
+  an attribute value. The markup is then walked in document order: as soon as the walk reaches a piece
+  of markup a thread found the rest of that chunk is taken as is, a chunk whose guess was wrong is simply
+  walked until the two meet.
+  */
+bool
+SimpleXmlIndex::buildParallel(const QString &msg, int threads)
+{
+    const int size = msg.size();
+    const int chunks = SimpleXmlParser::parallelChunkCount(size, threads);
+    if (chunks <= 1)
+        return build(msg);
+
+    m_msg = msg;
+    m_elements.clear();
+    const QChar *data = m_msg.constData();
+
+    struct ChunkMarkup
+    {
+        QVector<SimpleXmlParser::Markup> markups;
+        bool lastInMessage;         //no complete markup follows the last one found
+    };
+    QVector<ChunkMarkup> found(chunks);
+    SimpleXmlParser::runInChunks(size, chunks, [data, size, &found](int chunk, int from, int to) {
+        ChunkMarkup &chunkMarkup = found[chunk];
+        chunkMarkup.lastInMessage = false;
+        SimpleXmlParser::Markup markup;
+        int pos = from;
+        while (true) {
+            if (!SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+                chunkMarkup.lastInMessage = true;
+                break;
+            }
+            if (markup.begin >= to)
+                break;
+            chunkMarkup.markups << markup;
+            pos = markup.end;
+        }
+    });
+
+    Builder builder(*this);
+    SimpleXmlParser::Markup markup;
+    int pos = 0;
+    while (SimpleXmlParser::nextMarkup(data, size, pos, markup)) {
+        int chunk = int(qint64(markup.begin) * chunks / size);
+        while (chunk + 1 < chunks && SimpleXmlParser::chunkBegin(size, chunks, chunk + 1) <= markup.begin)
+            chunk++;
+        while (SimpleXmlParser::chunkBegin(size, chunks, chunk) > markup.begin)
+            chunk--;
+
+        //the markup following a piece of markup depends only on where that one ends
+        const QVector<SimpleXmlParser::Markup> &markups = found.at(chunk).markups;
+        int i = std::lower_bound(markups.constBegin(), markups.constEnd(), markup.begin,
+                                 [](const SimpleXmlParser::Markup &m, int begin) { return m.begin < begin; }) - markups.constBegin();
+        if (i == markups.size() || markups.at(i).begin != markup.begin) {
+            builder.add(markup);
+            pos = markup.end;
+            continue;
+        }
+        for (; i < markups.size(); i++)
+            builder.add(markups.at(i));
+        pos = markups.last().end;
+        if (found.at(chunk).lastInMessage)
+            break;
+    }
+    return builder.finish();
+}
+
+
+
+bool
+SimpleXmlIndex::nameIs(int e, QStringView name) const
+{
+    const Element &el = m_elements.at(e);
+    return el.nameLength == name.size()
+            && memcmp(m_msg.constData() + el.nameBegin, name.data(), el.nameLength * sizeof(QChar)) == 0;
+}
+
+
+
+QStringView
+SimpleXmlIndex::name(int e) const
+{
+    const Element &el = m_elements.at(e);
+    return QStringView(m_msg.constData() + el.nameBegin, el.nameLength);
+}
+
+
+
+/*!
+  \brief returns the raw text between the start and end tag of the element, child elements included
+  */
+QStringView
+SimpleXmlIndex::value(int e) const
+{
+    if (e < 0)
+        return QStringView();
+
+    const Element &el = m_elements.at(e);
+    return QStringView(m_msg.constData() + el.contentBegin, el.contentLength);
+}
+
+
+
+QString
+SimpleXmlIndex::decodedValue(int e) const
+{
+    return SimpleXmlParser::decodeEntities(value(e).toString());
+}
+
+
+
+SimpleXmlParser::AttributeIterator
+SimpleXmlIndex::attributes(int e) const
+{
+    if (e < 0)
+        return SimpleXmlParser::AttributeIterator();
+
+    const Element &el = m_elements.at(e);
+    const QChar *begin = m_msg.constData() + el.attributesBegin;
+    return SimpleXmlParser::AttributeIterator(begin, begin + el.attributesLength);
+}
+
+
+
+/*!
+  \return the raw value of the attribute \a name of the element, a null view if the attribute is not there
+  */
+QStringView
+SimpleXmlIndex::attribute(int e, const QString &name) const
+{
+    SimpleXmlParser::AttributeIterator it = attributes(e);
+    while (it.hasNext()) {
+        SimpleXmlParser::Attribute attr = it.next();
+        if (attr.name.size() == name.size() && memcmp(attr.name.data(), name.constData(), name.size() * sizeof(QChar)) == 0)
+            return attr.value;
+    }
+    return QStringView();
+}
+
+
+
+/*!
+  \return the first child of \a e named \a name, -1 if none. A negative \a e looks among the top level elements
+  */
+int
+SimpleXmlIndex::child(int e, const QString &name) const
+{
+    int c = e < 0 ? root() : m_elements.at(e).firstChild;
+    while (c >= 0 && !nameIs(c, name))
+        c = m_elements.at(c).nextSibling;
+    return c;
+}
+
+
+
+int
+SimpleXmlIndex::nextSibling(int e, const QString &name) const
+{
+    int c = m_elements.at(e).nextSibling;
+    while (c >= 0 && !nameIs(c, name))
+        c = m_elements.at(c).nextSibling;
+    return c;
+}
+
+
+
+/*!
+  \return the first element named \a name found in document order starting from the element \a from, -1 if none
+  */
+int
+SimpleXmlIndex::find(const QString &name, int from) const
+{
+    for (int e = qMax(from, 0); e < m_elements.size(); e++) {
+        if (nameIs(e, name))
+            return e;
+    }
+    return -1;
+}
+
+
+
+QVector<int>
+SimpleXmlIndex::findAll(const QString &name) const
+{
+    QVector<int> found;
+    for (int e = 0; e < m_elements.size(); e++) {
+        if (nameIs(e, name))
+            found << e;
+    }
+    return found;
+}
+
+
+
+/*!
+  \brief follows a path of child names like "PhaseList/Phase/Test" starting from the element \a from
+  When several children have the same name they are tried in document order.
+  \param from the element the path is relative to, the root by default, -1 to start from the top level elements
+  \return the first element matching the path, -1 if none
+  */
+int
+SimpleXmlIndex::path(const QString &path, int from) const
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,14,0)
+    QStringList steps = path.split("/", QString::SkipEmptyParts);
+#else
+    QStringList steps = path.split("/", Qt::SkipEmptyParts);
+#endif
+    if (m_elements.isEmpty())
+        return -1;
+
+    return pathFrom(from, steps, 0);
+}
+
+
+
+int
+SimpleXmlIndex::pathFrom(int e, const QStringList &steps, int step) const
+{
+    if (step == steps.size())
+        return e;
+
+    for (int c = child(e, steps.at(step)); c >= 0; c = nextSibling(c, steps.at(step))) {
+        int found = pathFrom(c, steps, step + 1);
+        if (found >= 0)
+            return found;
+    }
+    return -1;
+}
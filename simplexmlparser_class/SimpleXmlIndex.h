@@ -0,0 +1,74 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLINDEX_H
+#define SIMPLEXMLINDEX_H
+
+#include <QString>
+#include <QVector>
+
+#include "SimpleXmlParser.h"
+
+/*!
+ * @brief A message parsed once into a flat array of element records.
+ *   Lookups by name, child or path walk the records instead of rescanning the text.
+ *   The index keeps a (shared, not copied) reference to the message, so the views it
+ *   returns stay valid as long as the index itself is alive.
+ */
+class SimpleXmlIndex
+{
+public:
+    struct Element
+    {
+        int nameBegin, nameLength;
+        int attributesBegin, attributesLength;
+        int contentBegin, contentLength;    //an empty element tag has an empty content located after it
+        int parent;                         //-1 for the top level elements
+        int firstChild;                     //-1 if none
+        int nextSibling;                    //-1 if none
+        int depth;                          //0 for the top level elements
+    };
+
+    SimpleXmlIndex();
+    explicit SimpleXmlIndex(const QString &msg);
+
+    bool build(const QString &msg);
+    bool buildParallel(const QString &msg, int threads=0);
+    void clear();
+
+    QString message() const                                     { return m_msg;                 }
+    bool isEmpty() const                                        { return m_elements.isEmpty();  }
+    int count() const                                           { return m_elements.size();     }
+    const Element &element(int e) const                         { return m_elements.at(e);      }
+    int root() const                                            { return m_elements.isEmpty() ? -1 : 0; }
+
+    QStringView name(int e) const;
+    QStringView value(int e) const;
+    QString decodedValue(int e) const;
+    SimpleXmlParser::AttributeIterator attributes(int e) const;
+    QStringView attribute(int e, const QString &name) const;
+
+    int parent(int e) const                                     { return m_elements.at(e).parent;       }
+    int firstChild(int e) const                                 { return m_elements.at(e).firstChild;   }
+    int nextSibling(int e) const                                { return m_elements.at(e).nextSibling;  }
+    int child(int e, const QString &name) const;
+    int nextSibling(int e, const QString &name) const;
+
+    int find(const QString &name, int from=0) const;
+    QVector<int> findAll(const QString &name) const;
+    int path(const QString &path, int from=0) const;
+
+private:
+    struct Builder;
+
+    QString m_msg;
+    QVector<Element> m_elements;
+
+    bool nameIs(int e, QStringView name) const;
+    int pathFrom(int e, const QStringList &steps, int step) const;
+};
+
+#endif // SIMPLEXMLINDEX_H
@@ -5,10 +5,100 @@
  ********************************************************************************/
 
 #include "SimpleXmlParser.h"
+#include "SimpleXmlBind.h"
+#include "SimpleXmlIndex.h"
+#include "SimpleXmlScan.h"
 
+#include <QBuffer>
+#include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
+#include <QEventLoop>
 #include <QStringList>
-#include <QRegularExpression>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QTimer>
+#ifdef QT_NETWORK_LIB
+#include <QLocalServer>
+#include <QLocalSocket>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <limits.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * helpers to run the vectorized kernels of SimpleXmlScan on Qt strings
+ */
+static inline const char16_t *
+utf16(const QChar *data)
+{
+    return reinterpret_cast<const char16_t *>(data);
+}
+
+static inline int
+findChar(const QString &s, int from, char16_t c)
+{
+    return SimpleXmlScan::indexOf(utf16(s.constData()), s.size(), from, c);
+}
+
+static inline int
+findPattern(const QString &s, int from, const QString &pattern)
+{
+    return SimpleXmlScan::indexOf(utf16(s.constData()), s.size(), from, utf16(pattern.constData()), pattern.size());
+}
+
+/*!
+  \brief compares the text at \a data with the ASCII string \a s
+  */
+static bool
+matchesAscii(const QChar *data, int size, const char *s)
+{
+    int i = 0;
+    for (; s[i]; i++) {
+        if (i >= size || data[i] != QLatin1Char(s[i]))
+            return false;
+    }
+    return true;
+}
+
+/*!
+  \brief finds the '>' closing a tag starting the search at \a from, quoted attribute values are jumped over
+  \return the index of the '>', -1 if the tag is not complete, -2 if it is malformed, the framer uses the same rule
+  */
+static int
+findTagClose(const QChar *data, int size, int from)
+{
+    return SimpleXmlCore16::findTagClose(utf16(data), size, from);
+}
+
+/*!
+  \brief tells the kernel that the \a length bytes mapped at \a data are going to be read once, in order
+  The pages are then read ahead more aggressively and can be dropped soon after they have been read.
+  */
+static void
+adviseSequential(const uchar *data, qint64 length)
+{
+#ifdef Q_OS_UNIX
+    //the advice goes on whole pages, the mapping itself starts at the page boundary before data
+    const quintptr page = quintptr(sysconf(_SC_PAGESIZE));
+    const quintptr begin = quintptr(data) & ~(page - 1);
+    posix_madvise(reinterpret_cast<void *>(begin), size_t(quintptr(data) + quintptr(length) - begin), POSIX_MADV_SEQUENTIAL);
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+#endif
+}
 
 /*!
    \class SimpleXmlParser
@@ -18,12 +108,107 @@
   */
 SimpleXmlParser::SimpleXmlParser(QObject *parent)
     : QObject(parent),
-      m_maxBufferSizeInBytes(0)
+      m_parsedMessages(1024),
+      m_maxBufferSizeInBytes(0),
+      m_batchTimer(0),
+      m_batchWindowMsecs(0),
+      m_batchMaxMessages(0),
+      m_readChunkSize(16384),
+      m_queueHighWaterMark(0),
+      m_readPaused(false),
+      m_mapWindowBytes(64 * 1024 * 1024),
+      m_spillThreshold(0)
 {
     m_notifyMode = E_NotifyOnly;
+    m_queueFullPolicy = E_QueueReject;
+    m_bufferFullPolicy = E_BufferReject;
+}
+
+
+/*!
+  \brief sets the name of the tag enclosing the messages, replacing the ones set before
+  The start tag of a message may carry attributes (<aTag attr="...">) and an empty element tag
+  (<aTag/>) is a message by itself.
+  */
+void
+SimpleXmlParser::setStartTag(const QString &aTag)
+{
+    QByteArray utf8Tag = aTag.toUtf8();
+    m_core.setStartTag(SimpleXmlCore16::View(utf16(aTag.constData()), aTag.size()));
+    m_utf8Core.setStartTag(SimpleXmlCoreUtf8::View(utf8Tag.constData(), utf8Tag.size()));
+    m_spillFile.clear();
+}
+
+
+
+/*!
+  \brief adds one more tag enclosing messages, so several kinds of messages are framed from the same stream
+  All the start tags are recognized in the same scan of the data, getNextMessage() tells which one a
+  message was framed with. A message ends with the end tag of its own start tag.
+  */
+void
+SimpleXmlParser::addStartTag(const QString &aTag)
+{
+    QByteArray utf8Tag = aTag.toUtf8();
+    m_core.addStartTag(SimpleXmlCore16::View(utf16(aTag.constData()), aTag.size()));
+    m_utf8Core.addStartTag(SimpleXmlCoreUtf8::View(utf8Tag.constData(), utf8Tag.size()));
+}
+
+
+
+QString
+SimpleXmlParser::startTagName(int startTag) const
+{
+    if (startTag < 0 || startTag >= m_core.startTagCount())
+        return QString();
+    SimpleXmlCore16::View name = m_core.startTagName(startTag);
+    return QString(reinterpret_cast<const QChar *>(name.data()), int(name.size()));
+}
+
+
+/*!
+  \brief registers a tag whose elements are signalled with foundTag() while the messages are framed
+  The angular brackets are stripped so both "tag" and "<tag>" are accepted.
+  */
+void
+SimpleXmlParser::addTagToFind(const QString &aTag)
+{
+    QString name = TagQuery(aTag).name();
+    if (name.isEmpty() || m_TagsToSignal.contains(name))
+        return;
+
+    //both cores number the tags in the order they are added, as m_TagsToSignal does
+    QByteArray utf8Name = name.toUtf8();
+    m_core.addTagToFind(SimpleXmlCore16::View(utf16(name.constData()), name.size()));
+    m_utf8Core.addTagToFind(SimpleXmlCoreUtf8::View(utf8Name.constData(), utf8Name.size()));
+    m_TagsToSignal.append(name);
+}
+
+
+
+/*!
+  \brief sets how many parsed messages can wait to be taken, rounded up to a power of two (1024 by default)
+  When the queue is full the policy set with setQueueFullPolicy() applies, E_QueueReject by default.
+  E_QueueFull is emitted for every message rejected or dropped, none is lost silently.
+  \note the pending messages are dropped, call it before feeding data and while no other thread takes messages
+  */
+void
+SimpleXmlParser::setQueueCapacity(int capacity)
+{
+    if (capacity > 0) {
+        m_parsedMessages.setCapacity(capacity);
+    }
 }
 
 
+
+/*!
+  \brief sets how many bytes of a message still in progress can be buffered, 0 (the default) means unlimited
+  When a message does not fit E_MessageTooBig is emitted and what happens depends on the buffer full policy:
+  with E_BufferReject (the default) the data is dropped until emptyBuffer() is called, with E_BufferResync
+  the message is dropped instead and the parser goes on from the next start tag, so the buffer never
+  grows beyond the limit (see getSkippedBytes()).
+  */
 void
 SimpleXmlParser::setMaxBufferSize(int sizeInBytes)
 {
@@ -33,10 +218,57 @@ SimpleXmlParser::setMaxBufferSize(int sizeInBytes)
 }
 
 
+/*!
+  \brief the data not framed yet, converted from UTF-8 when the parser is fed with addUtf8Data()
+  */
 QString
 SimpleXmlParser::getCurrentBuffer() const
 {
-    return m_buffer;
+    if (m_utf8Core.bufferSize() > 0)
+        return QString::fromUtf8(m_utf8Core.buffer().data(), m_utf8Core.bufferSize());
+
+    return QString(reinterpret_cast<const QChar *>(m_core.buffer().data()), m_core.bufferSize());
+}
+
+
+
+QByteArray
+SimpleXmlParser::getCurrentBufferUtf8() const
+{
+    return QByteArray(m_utf8Core.buffer().data(), m_utf8Core.bufferSize());
+}
+
+
+
+/*!
+  \brief the bytes dropped with the messages too big for the buffer in E_BufferResync mode, up to the start tag that followed them
+  The data fed with addData() is counted two bytes per character, as the buffer limit is.
+  */
+qint64
+SimpleXmlParser::getSkippedBytes() const
+{
+    return m_core.skippedCount() * qint64(sizeof(QChar)) + m_utf8Core.skippedCount();
+}
+
+
+
+/*!
+  \brief moves a message in progress to a temporary file in \a directory (the system one if empty) once it takes more than \a sizeInBytes of buffer
+  From then on only what arrives between two scans is kept in memory, so the memory used does not depend
+  on the size of the message. The message, when complete, is written in UTF-8 and emitted with
+  parsedMessageFile() instead of being queued or dispatched; the file can be mapped or read in pieces and
+  is removed when the last reference to it is dropped. The tags to find opened in the part moved to the
+  file are not signalled. If the file can not be written E_SpillFailed is emitted and the message dropped.
+  0 (the default) never spills.
+  \note the messages parseFile() frames in place in the mapped file are not spilled
+  */
+void
+SimpleXmlParser::setSpillThreshold(int sizeInBytes, const QString &directory)
+{
+    if (sizeInBytes >= 0) {
+        m_spillThreshold = sizeInBytes;
+        m_spillDirectory = directory;
+    }
 }
 
 
@@ -44,106 +276,321 @@ SimpleXmlParser::getCurrentBuffer() const
 void
 SimpleXmlParser::emptyBuffer()
 {
-    m_buffer.clear();
+    m_core.clear();
+    m_utf8Core.clear();
+    m_spillFile.clear();
 }
 
 
 
-QString
-SimpleXmlParser::unquoteString(const QString &s)
+/*!
+  \brief decodes the entity beginning with the '&' at \a data
+  \param out receives the decoded character, two UTF-16 units for code points above U+FFFF
+  \param outLen the number of units written in \a out
+  \return the length of the entity, 0 if \a data does not begin with a known entity
+  */
+static int
+decodeEntityAt(const QChar *data, int size, QChar *out, int &outLen)
 {
-    if ( s.at(0) == s.at(s.length()-1) && ( s.at(0) == '\'' || s.at(0) == '"' ) )
-        return s.mid(1, s.length() - 2);
+    static const struct { const char *name; char16_t value; } named[] = {
+        { "&amp;", u'&' }, { "&lt;", u'<' }, { "&gt;", u'>' }, { "&quot;", u'"' }, { "&apos;", u'\'' }
+    };
+
+    outLen = 1;
+    if (size < 4)
+        return 0;
+
+    if (data[1] != '#') {
+        for (unsigned int i = 0; i < sizeof(named) / sizeof(named[0]); i++) {
+            if (matchesAscii(data, size, named[i].name)) {
+                out[0] = QChar(named[i].value);
+                return int(strlen(named[i].name));
+            }
+        }
+        return 0;
+    }
 
-    return s;
+    const bool hex = (data[2] == 'x' || data[2] == 'X');
+    int p = hex ? 3 : 2;
+    const int digitsBegin = p;
+    uint code = 0;
+    for (; p < size; p++) {
+        ushort c = data[p].unicode();
+        uint digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (hex && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (hex && c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            break;
+        code = qMin(code * (hex ? 16 : 10) + digit, 0x110000u);     //saturate, anything above U+10FFFF is invalid
+    }
+    if (p == digitsBegin || p >= size || data[p] != ';' || code > 0x10FFFF)
+        return 0;
+
+    if (QChar::requiresSurrogates(code)) {
+        out[0] = QChar(QChar::highSurrogate(code));
+        out[1] = QChar(QChar::lowSurrogate(code));
+        outLen = 2;
+    }
+    else {
+        out[0] = QChar(ushort(code));
+    }
+    return p + 1;
 }
 
 
 
+/*!
+  \brief decodes the entities in a single pass, the text is copied only if there is something to decode
+  Entities are decoded once, so "&amp;lt;" gives "&lt;". Unknown or malformed entities are left as they are
+  and the invalid characters (U+FFFD) are replaced by a space.
+  */
 QString
 SimpleXmlParser::decodeEntities(const QString &s)
 {
-    QString ret(s);
-    ret.replace("&amp;", "&").replace("&gt;", ">").replace("&lt;", "<").replace("&quot;", "\"").replace("&apos;", "'");
+    static const char16_t special[] = { u'&', u'\xFFFD' };
+    const QChar *data = s.constData();
+    const int size = s.size();
+
+    int pos = SimpleXmlScan::findFirstOf(utf16(data), size, 0, special, 2);
+    if (pos < 0)
+        return s;
+
+    //an entity is always longer than what it decodes to so the input size is enough
+    QString ret(size, Qt::Uninitialized);
+    QChar *out = ret.data();
+    int written = 0;
+    int last = 0;
+
+    while (pos >= 0) {
+        memcpy(out + written, data + last, (pos - last) * sizeof(QChar));
+        written += pos - last;
+
+        int len = 1;
+        if (data[pos].unicode() == 0xFFFD) {
+            out[written++] = QLatin1Char(' ');
+        }
+        else {
+            int decodedLen;
+            len = decodeEntityAt(data + pos, size - pos, out + written, decodedLen);
+            if (len > 0) {
+                written += decodedLen;
+            }
+            else {
+                out[written++] = data[pos];
+                len = 1;
+            }
+        }
+        last = pos + len;
+        pos = SimpleXmlScan::findFirstOf(utf16(data), size, last, special, 2);
+    }
+    memcpy(out + written, data + last, (size - last) * sizeof(QChar));
+    written += size - last;
+
+    ret.resize(written);
+    return ret;
+}
+
+
+
+/*!
+  \brief returns the number of hex digits needed to write \a code
+  */
+static inline int
+hexDigits(uint code)
+{
+    int n = 1;
+    while (code >>= 4)
+        n++;
+    return n;
+}
 
-    // remove invalid chars (replacement char has U+FFFD as unicode code)
-    ret.replace(QChar(0xFFFD), " ");
 
-    QRegularExpression re("&#([0-9]+);|&#x([0-9A-F]+);",
-                          QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
 
-    QRegularExpressionMatchIterator i = re.globalMatch(ret);
-    int offset = 0;
-    while (i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        QString matched = match.captured(0);
-        int position = match.capturedStart();
-        int length = matched.length();
-        QString decoded = QChar(matched.startsWith("&#x") ? match.captured(2).toInt(0, 16) : match.captured(1).toInt(0, 10));
+/*!
+  \brief returns the code point starting at \a i and how many UTF-16 units it takes
+  */
+static inline uint
+codePointAt(const QChar *data, int size, int i, int &units)
+{
+    if (data[i].isHighSurrogate() && i + 1 < size && data[i + 1].isLowSurrogate()) {
+        units = 2;
+        return QChar::surrogateToUcs4(data[i], data[i + 1]);
+    }
+    units = 1;
+    return data[i].unicode();
+}
+
 
-        ret.replace(position + offset, length, decoded);
-        offset += decoded.length() - length;
+
+/*!
+  \brief computes the length of the text once encoded, so the output is allocated once
+  */
+static int
+encodedLength(const QChar *data, int size, bool encodeNonAscii)
+{
+    int len = 0;
+    for (int i = 0; i < size; i++) {
+        ushort c = data[i].unicode();
+        switch (c) {
+        case '&':   len += 5;   break;
+        case '<':
+        case '>':   len += 4;   break;
+        case '"':
+        case '\'':  len += 6;   break;
+        default:
+            if (encodeNonAscii && c > 128) {
+                int units;
+                len += hexDigits(codePointAt(data, size, i, units)) + 4;
+                i += units - 1;
+            }
+            else {
+                len++;
+            }
+        }
     }
+    return len;
+}
 
-    return ret;
+
+
+static inline QChar *
+writeAscii(QChar *out, const char *s)
+{
+    while (*s)
+        *out++ = QLatin1Char(*s++);
+    return out;
 }
 
 
 
-QString
-SimpleXmlParser::encodeEntities(const QString &s, bool encodeNonAscii)
+/*!
+  \brief writes the encoded text at \a out, there must be room for encodedLength() characters
+  */
+static void
+writeEncoded(const QChar *data, int size, bool encodeNonAscii, QChar *out)
 {
-    QString ret(s);
-    if (encodeNonAscii)
-    {
-        uint len = ret.length();
-        uint i = 0;
-        while(i < len)
-        {
-            if(ret[i].unicode() > 128)
-            {
-                QString rp = "&#x" + QString::number(ret[i].unicode(), 16) + ";";
-                ret.replace(i, 1, rp);
-                len += rp.length() -1;
-                i += rp.length();
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < size; i++) {
+        ushort c = data[i].unicode();
+        switch (c) {
+        case '&':   out = writeAscii(out, "&amp;");     break;
+        case '<':   out = writeAscii(out, "&lt;");      break;
+        case '>':   out = writeAscii(out, "&gt;");      break;
+        case '"':   out = writeAscii(out, "&quot;");    break;
+        case '\'':  out = writeAscii(out, "&apos;");    break;
+        default:
+            if (encodeNonAscii && c > 128) {
+                int units;
+                uint code = codePointAt(data, size, i, units);
+                i += units - 1;
+                out = writeAscii(out, "&#x");
+                for (int d = hexDigits(code) - 1; d >= 0; d--)
+                    *out++ = QLatin1Char(hex[(code >> (4 * d)) & 0xF]);
+                *out++ = QLatin1Char(';');
             }
-            else
-            {
-                i++;
+            else {
+                *out++ = data[i];
             }
         }
     }
-    ret.replace("&", "&amp;").replace(">", "&gt;").replace("<", "&lt;").replace("\"", "&quot;").replace("'", "&apos;");
+}
+
+
+
+/*!
+  \brief escapes the text in a single pass, the text is copied only if there is something to escape
+  Characters above U+FFFF are written as a single numeric entity.
+  */
+QString
+SimpleXmlParser::encodeEntities(const QString &s, bool encodeNonAscii)
+{
+    const int len = encodedLength(s.constData(), s.size(), encodeNonAscii);
+    if (len == s.size())
+        return s;
+
+    QString ret(len, Qt::Uninitialized);
+    writeEncoded(s.constData(), s.size(), encodeNonAscii, ret.data());
     return ret;
 }
 
 
 
-bool
-SimpleXmlParser::findStartTagDelimiters(const QString &i_msg, const QString &i_tagname, int i_beginidx, int &o_startIdx, int &o_endIdx)
+/*!
+  \brief same as encodeEntities() but the encoded text is appended to \a out
+  Use it to encode many strings reusing the same buffer: truncating \a out with resize(0) keeps its memory
+  (unlike clear()) and the buffer grows only when a longer text comes.
+  */
+void
+SimpleXmlParser::appendEncodedEntities(QString &out, const QString &s, bool encodeNonAscii)
 {
-    QRegularExpression rx("<"+i_tagname+"[>|\\s]");     //find the beginning of the start tag (we use the \\s to avoid mismatches
-    QRegularExpression endrx("(>|/>)");            //to check where the start tag ends (handling properties)
+    const int len = encodedLength(s.constData(), s.size(), encodeNonAscii);
+    const int base = out.size();
+    out.resize(base + len);
+    writeEncoded(s.constData(), s.size(), encodeNonAscii, out.data() + base);
+}
+
+
+
+/*!
+  \brief prepares the search patterns for \a tag, the angular brackets are stripped so both "tag" and "<tag>" are accepted
+  */
+SimpleXmlParser::TagQuery::TagQuery(const QString &tag)
+{
+    m_name.reserve(tag.size());
+    foreach (QChar c, tag) {
+        if (c != '<' && c != '>')
+            m_name.append(c);
+    }
+    m_startTag = "<" + m_name;
+    m_endTag = "</" + m_name + ">";
+}
 
 
-    QRegularExpressionMatch startMatch = rx.match(i_msg, i_beginidx);
-        o_startIdx = startMatch.capturedStart();
-        if (!startMatch.hasMatch()) {
-            return false;
-        }
 
-        QRegularExpressionMatch endMatch = endrx.match(i_msg, o_startIdx);
-        o_endIdx = endMatch.capturedStart();
-        if (!endMatch.hasMatch()) {
+/*!
+  \brief finds the start tag of \a i_tag beginning the search at \a i_beginidx
+  \param o_startIdx the index of the '<' of the start tag, -1 if the tag was not found
+  \param o_endIdx the index of the '>' closing the start tag, -1 if it was not found
+  \return true if the tag is an empty element tag (i.e. <tag/>)
+  */
+bool
+SimpleXmlParser::findStartTagDelimiters(const QString &i_msg, const TagQuery &i_tag, int i_beginidx, int &o_startIdx, int &o_endIdx)
+{
+    const int patternLen = i_tag.m_startTag.size();
+    int idx = i_beginidx;
+
+    o_endIdx = -1;
+    //find the beginning of the start tag, it must be followed by '>' or a space to avoid matching longer tag names
+    while (true) {
+        idx = findPattern(i_msg, idx, i_tag.m_startTag);
+        if (idx < 0) {
+            o_startIdx = -1;
             return false;
         }
+        int next = idx + patternLen;
+        if (next < i_msg.size() && (i_msg.at(next) == '>' || i_msg.at(next).isSpace())) {
+            //check where the start tag ends (handling properties, their values may contain '>')
+            o_endIdx = findTagClose(i_msg.constData(), i_msg.size(), next);
+            if (o_endIdx != -2)
+                break;
+            o_endIdx = -1;      //malformed, look for the next one
+        }
+        idx++;
+    }
+    o_startIdx = idx;
+    if (o_endIdx < 0) {
+        return false;
+    }
 
-    #ifdef SXML_DBG
-        qDebug() << "Matched/captured text:" << endMatch.capturedTexts();
-        qDebug() << "idx, endix: " << o_startIdx << o_endIdx;
-    #endif
+#ifdef SXML_DBG
+    qDebug() << "idx, endix: " << o_startIdx << o_endIdx;
+#endif
 
-        return endMatch.captured(1) == "/>";
+    return i_msg.at(o_endIdx - 1) == '/';
 }
 
 
@@ -159,33 +606,63 @@ SimpleXmlParser::findStartTagDelimiters(const QString &i_msg, const QString &i_t
 QString
 SimpleXmlParser::getTagValue(const QString & i_msg, const QString & i_tag, int i_offset, QString defaultValue)
 {
-    QString tagname = i_tag;
-    tagname.remove(QRegularExpression("[<>]"));
-    QString endtag = "</" + tagname + ">";
+    return getTagValue(i_msg, TagQuery(i_tag), i_offset, defaultValue);
+}
+
+
+
+QString
+SimpleXmlParser::getTagValue(const QString &i_msg, const TagQuery &i_tag, int i_offset, QString defaultValue)
+{
+    QStringView value = getTagValueView(i_msg, i_tag, i_offset);
+    if (value.isNull())
+        return defaultValue;
+
+    return value.toString();
+}
+
+
 
+/*!
+  \brief same as getTagValue() but the value is not copied
+  \return a view on the value inside \a i_msg, a null view if the tag was not found
+  */
+QStringView
+SimpleXmlParser::getTagValueView(const QString &i_msg, const TagQuery &i_tag, int i_offset)
+{
     int idx, endidx;
-    bool emptytag = findStartTagDelimiters(i_msg, tagname, i_offset, idx, endidx);
+    bool emptytag = findStartTagDelimiters(i_msg, i_tag, i_offset, idx, endidx);
 
 #ifdef SXML_DBG
     qDebug() << "idx, endix: " << idx << endidx;
 #endif
     if (emptytag) {
-        return "";
+        return QStringView(i_msg.constData() + endidx + 1, 0);
     }
 
     //it was not empty... go on
-    int idx2 = i_msg.indexOf(endtag, idx);
-    if (idx < 0 || idx2 < 0)
-        return defaultValue;
+    if (idx < 0 || endidx < 0)
+        return QStringView();
+
+    int idx2 = findPattern(i_msg, endidx + 1, i_tag.m_endTag);
+    if (idx2 < 0)
+        return QStringView();
 
-    QString tag = i_msg.mid(endidx + 1, idx2 - (endidx + 1));
-    return tag;
+    return QStringView(i_msg.constData() + endidx + 1, idx2 - (endidx + 1));
 }
 
 
 
 QString
 SimpleXmlParser::getDecodedTagValue(const QString &msg, const QString &tag, int beginidx, QString defaultValue)
+{
+    return decodeEntities(getTagValue(msg, TagQuery(tag), beginidx, defaultValue));
+}
+
+
+
+QString
+SimpleXmlParser::getDecodedTagValue(const QString &msg, const TagQuery &tag, int beginidx, QString defaultValue)
 {
     return decodeEntities(getTagValue(msg, tag, beginidx, defaultValue));
 }
@@ -193,110 +670,305 @@ SimpleXmlParser::getDecodedTagValue(const QString &msg, const QString &tag, int
 
 
 /*!
-  \brief this method counts the number of tag occurence in the message and then calls repeatedly the getTagValue passing the specific offset
+  \brief this method collects the values of every occurrence of the tag in a single forward scan of the message
   \param _msg the entire message to parse
   \param _tag the tag we want to gather the values
+  \param endOffsets if not null, for each value it receives the offset just past the end of its element
   \return a list of string containing all the values of the specified tags
   */
 QStringList
-SimpleXmlParser::getTagsValues(const QString & _msg, const QString & _tag)
-{
-        QStringList vlist;
-        int idx,last=0;
-        QString ntag = _tag;
-        ntag.remove(QRegularExpression("[<>]"));
-        QRegularExpression rx("<" + ntag + "[\\s*|>]");
-        int numtags = _msg.count(rx);
-        for (int i=0; i<numtags; i++) {
-#ifdef SXML_DBG
-            qDebug() << "parsing loop " << i << " idx=" << last;
-#endif
-            idx = _msg.indexOf(rx,last);
-            vlist << getTagValue(_msg,_tag,idx);
-            last = idx+1;
-        }
-        return vlist;
+SimpleXmlParser::getTagsValues(const QString & _msg, const QString & _tag, QList<int> *endOffsets)
+{
+    return getTagsValues(_msg, TagQuery(_tag), endOffsets);
 }
 
 
 
 QStringList
-SimpleXmlParser::getDecodedTagsValues(const QString &msg, const QString &tag)
+SimpleXmlParser::getTagsValues(const QString &_msg, const TagQuery &_tag, QList<int> *endOffsets)
 {
-    QStringList rawValues = getTagsValues(msg, tag);
-    QStringList retval;
-    foreach(QString rawVal, rawValues) {
-        retval << decodeEntities(rawVal);
+    QStringList vlist;
+    foreach (QStringView value, getTagsValuesViews(_msg, _tag, endOffsets)) {
+        vlist << value.toString();
     }
-    return retval;
+    return vlist;
 }
 
 
 
-QMap<QString, QString>
-SimpleXmlParser::getTagProperties(const QString &i_msg, const QString &i_tag, int i_offset)
+/*!
+  \brief same as getTagsValues() but the values are not copied, a tag without a value gives a null view
+  */
+QVector<QStringView>
+SimpleXmlParser::getTagsValuesViews(const QString &_msg, const TagQuery &_tag, QList<int> *endOffsets)
 {
-    QMap<QString, QString> map;
+        QVector<QStringView> vlist;
+        const QChar *data = _msg.constData();
+        int idx, endidx, last=0;
+        int endTagIdx = -1;         //the closing tag found for the previous value
+        bool endTagsLeft = true;
+
+        while (true) {
+            bool emptytag = findStartTagDelimiters(_msg, _tag, last, idx, endidx);
+            if (idx < 0)
+                break;
+            if (endidx < 0) {       //unterminated start tag, nothing else can be found after it
+                vlist << QStringView();
+                if (endOffsets)
+                    *endOffsets << _msg.size();
+                break;
+            }
+#ifdef SXML_DBG
+            qDebug() << "parsing loop idx=" << idx;
+#endif
+            int end = endidx + 1;
+            if (emptytag) {
+                vlist << QStringView(data + end, 0);
+            }
+            else {
+                //the closing tag of a previous value is still the first one following a nested start tag,
+                //search again only when we went past it so the message is scanned once
+                if (endTagsLeft && endTagIdx <= endidx) {
+                    endTagIdx = findPattern(_msg, endidx + 1, _tag.m_endTag);
+                    endTagsLeft = endTagIdx >= 0;
+                }
+                if (endTagsLeft) {
+                    vlist << QStringView(data + endidx + 1, endTagIdx - (endidx + 1));
+                    end = endTagIdx + _tag.m_endTag.size();
+                }
+                else {
+                    vlist << QStringView();
+                }
+            }
+            if (endOffsets)
+                *endOffsets << end;
+            last = idx+1;
+        }
+        return vlist;
+}
 
-    QString tagname = i_tag;
-    tagname.remove(QRegularExpression("[<>]"));
 
-    int idx, endidx;
-    findStartTagDelimiters(i_msg, tagname, i_offset, idx, endidx);
 
-    QString tmpprop = i_msg.mid(idx + tagname.length() + 1, endidx - (idx + tagname.length() + 1) );
+/*!
+  \brief the same as getTagsValues() with the message split in chunks scanned by up to \a threads threads
+  (0 for one per core), meant for very large messages. The result is identical to getTagsValues().
+  Each thread finds the start and end tags beginning in its chunk, reading past its end when a tag crosses
+  it, then the values are paired with their end tags in a quick pass on what was found.
+  */
+QStringList
+SimpleXmlParser::getTagsValuesParallel(const QString &msg, const QString &tag, int threads, QList<int> *endOffsets)
+{
+    return getTagsValuesParallel(msg, TagQuery(tag), threads, endOffsets);
+}
 
-#ifdef SXML_DBG
-    qDebug() << "Properties string: " << tmpprop;
-#endif
 
-    tmpprop.replace(QRegularExpression("\\s*=\\s*"),"=");
 
-#ifdef SXML_DBG
-    qDebug() << "sanitized Properties string: " << tmpprop.trimmed();
-#endif
+QStringList
+SimpleXmlParser::getTagsValuesParallel(const QString &msg, const TagQuery &tag, int threads, QList<int> *endOffsets)
+{
+    QStringList vlist;
+    foreach (QStringView value, getTagsValuesViewsParallel(msg, tag, threads, endOffsets)) {
+        vlist << value.toString();
+    }
+    return vlist;
+}
 
-    QStringList sl;
 
-    QRegularExpression rx("(\\w+(?:(?:-\\w+)*)?=\".*\")", QRegularExpression::UseUnicodePropertiesOption);
-    QRegularExpressionMatchIterator rxMatchIterator = rx.globalMatch(tmpprop.trimmed());
 
-    while (rxMatchIterator.hasNext()) {
-        QRegularExpressionMatch match = rxMatchIterator.next();
-        if (match.hasMatch() && !match.captured(0).isEmpty()) {
-            sl << match.captured(0);
+/*!
+  \brief same as getTagsValuesParallel() but the values are not copied, see getTagsValuesViews()
+  */
+QVector<QStringView>
+SimpleXmlParser::getTagsValuesViewsParallel(const QString &msg, const TagQuery &tag, int threads, QList<int> *endOffsets)
+{
+    const int size = msg.size();
+    const int chunks = parallelChunkCount(size, threads);
+    if (chunks <= 1)
+        return getTagsValuesViews(msg, tag, endOffsets);
+
+    QVector<TagCandidates> found(chunks);
+    runInChunks(size, chunks, [&msg, &tag, &found](int chunk, int from, int to) {
+        findTagCandidates(msg, tag, from, to, found[chunk]);
+    });
+
+    TagCandidates all;
+    for (int c = 0; c < chunks; c++) {
+        all.starts += found.at(c).starts;
+        all.closes += found.at(c).closes;
+        all.ends += found.at(c).ends;
+    }
+    found.clear();
+
+    //the same pairing as getTagsValuesViews(), the searches become lookups in what the threads found
+    QVector<QStringView> vlist;
+    const QChar *data = msg.constData();
+    int endTagIdx = -1;
+    bool endTagsLeft = true;
+    for (int i = 0; i < all.starts.size(); i++) {
+        int endidx = all.closes.at(i);
+        if (endidx < 0) {
+            vlist << QStringView();
+            if (endOffsets)
+                *endOffsets << size;
+            break;
+        }
+        int end = endidx + 1;
+        if (data[endidx - 1] == '/') {
+            vlist << QStringView(data + end, 0);
+        }
+        else {
+            if (endTagsLeft && endTagIdx <= endidx) {
+                QVector<int>::const_iterator next = std::upper_bound(all.ends.constBegin(), all.ends.constEnd(), endidx);
+                endTagsLeft = next != all.ends.constEnd();
+                endTagIdx = endTagsLeft ? *next : -1;
+            }
+            if (endTagsLeft) {
+                vlist << QStringView(data + endidx + 1, endTagIdx - (endidx + 1));
+                end = endTagIdx + tag.m_endTag.size();
+            }
+            else {
+                vlist << QStringView();
+            }
         }
+        if (endOffsets)
+            *endOffsets << end;
     }
+    return vlist;
+}
 
-    QRegularExpression rx2("(\\w+(?:(?:-\\w+)*)?='[^']*')", QRegularExpression::UseUnicodePropertiesOption);
 
-    QRegularExpressionMatchIterator rx2MatchIterator = rx2.globalMatch(tmpprop.trimmed());
-    while (rx2MatchIterator.hasNext()) {
-        QRegularExpressionMatch match = rx2MatchIterator.next();
-        sl << match.captured();
+
+/*!
+  \brief finds the start and end tags of \a tag whose '<' is between \a from and \a to, as getTagsValuesViews() would
+  */
+void
+SimpleXmlParser::findTagCandidates(const QString &msg, const TagQuery &tag, int from, int to, TagCandidates &found)
+{
+    const char16_t *text = utf16(msg.constData());
+    const int size = msg.size();
+    const int startLen = tag.m_startTag.size();
+    const int endLen = tag.m_endTag.size();
+    const char16_t *startTag = utf16(tag.m_startTag.constData());
+    const char16_t *endTag = utf16(tag.m_endTag.constData());
+
+    int p = from;
+    while ((p = SimpleXmlScan::indexOf(text, to, p, u'<')) >= 0) {
+        if (p + startLen <= size && memcmp(text + p, startTag, startLen * sizeof(char16_t)) == 0) {
+            int next = p + startLen;
+            if (next < size && (msg.at(next) == '>' || msg.at(next).isSpace())) {
+                //a malformed start tag is skipped, as findStartTagDelimiters() does
+                int close = findTagClose(msg.constData(), size, next);
+                if (close != -2) {
+                    found.starts << p;
+                    found.closes << close;
+                }
+            }
+        }
+        if (p + endLen <= size && memcmp(text + p, endTag, endLen * sizeof(char16_t)) == 0) {
+            found.ends << p;
+        }
+        p++;
     }
+}
 
-#ifdef SXML_DBG
-    qDebug() << "prop string list: " << sl;
-#endif
 
-    foreach (QString s, sl) {
 
-#ifdef SXML_DBG
-        qDebug() << "Found Property: " << s;
-#endif
+int SimpleXmlParser::s_parallelMinChunk = 1 << 16;
+
+
+
+/*!
+  \brief how many chunks a message of \a size characters is split into for \a threads threads (0 for one per core)
+  */
+int
+SimpleXmlParser::parallelChunkCount(int size, int threads)
+{
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    return qBound(1, size / s_parallelMinChunk, threads);
+}
+
+
+
+/*!
+  \brief runs \a work on each of the \a chunks parts of a message of \a size characters, one thread per chunk
+  The calling thread takes the first chunk and returns once all of them are done.
+  */
+void
+SimpleXmlParser::runInChunks(int size, int chunks, const std::function<void(int chunk, int from, int to)> &work)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(size_t(chunks - 1));
+    for (int c = 1; c < chunks; c++) {
+        threads.push_back(std::thread(work, c, chunkBegin(size, chunks, c), chunkBegin(size, chunks, c + 1)));
+    }
+    work(0, 0, chunkBegin(size, chunks, 1));
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+
+
+QStringList
+SimpleXmlParser::getDecodedTagsValues(const QString &msg, const QString &tag)
+{
+    return getDecodedTagsValues(msg, TagQuery(tag));
+}
+
+
+
+QStringList
+SimpleXmlParser::getDecodedTagsValues(const QString &msg, const TagQuery &tag)
+{
+    QStringList rawValues = getTagsValues(msg, tag);
+    QStringList retval;
+    foreach(QString rawVal, rawValues) {
+        retval << decodeEntities(rawVal);
+    }
+    return retval;
+}
 
-#if QT_VERSION < QT_VERSION_CHECK(5,14,0)
-        QStringList sl2 = s.trimmed().split("=",QString::SkipEmptyParts);
-#else
-        QStringList sl2 = s.trimmed().split("=",Qt::SkipEmptyParts);
-#endif
+
+
+QMap<QString, QString>
+SimpleXmlParser::getTagProperties(const QString &i_msg, const QString &i_tag, int i_offset)
+{
+    return getTagProperties(i_msg, TagQuery(i_tag), i_offset);
+}
+
+
+
+QMap<QString, QString>
+SimpleXmlParser::getTagProperties(const QString &i_msg, const TagQuery &i_tag, int i_offset)
+{
+    int idx, endidx;
+    bool emptytag = findStartTagDelimiters(i_msg, i_tag, i_offset, idx, endidx);
+    if (idx < 0 || endidx < 0)
+        return QMap<QString, QString>();
+
+    return parseProperties(i_msg, idx + i_tag.m_startTag.length(), endidx - (emptytag ? 1 : 0));
+}
+
+
+
+/*!
+  \brief parses the attributes found in the start tag text between \a i_beginidx and \a i_endidx
+  */
+QMap<QString, QString>
+SimpleXmlParser::parseProperties(const QString &i_msg, int i_beginidx, int i_endidx)
+{
+    QMap<QString, QString> map;
+    const QChar *data = i_msg.constData();
 
 #ifdef SXML_DBG
-        qDebug() << sl2;
+    qDebug() << "Properties string: " << i_msg.mid(i_beginidx, i_endidx - i_beginidx);
 #endif
 
-        map[sl2.at(0).trimmed()] = unquoteString(sl2.at(1));
+    AttributeIterator it(data + i_beginidx, data + i_endidx);
+    while (it.hasNext()) {
+        Attribute attr = it.next();
+        map.insert(attr.name.toString(), attr.value.toString());
     }
 
     return map;
@@ -305,325 +977,2923 @@ SimpleXmlParser::getTagProperties(const QString &i_msg, const QString &i_tag, in
 
 
 QList<QMap<QString, QString> >
-SimpleXmlParser::getTagsProperties(const QString &i_msg, const QString &i_tag)
+SimpleXmlParser::getTagsProperties(const QString &i_msg, const QString &i_tag, QList<int> *endOffsets)
+{
+    return getTagsProperties(i_msg, TagQuery(i_tag), endOffsets);
+}
+
+
+
+/*!
+  \brief collects the attributes of every occurrence of the tag in a single forward scan of the message
+  \param endOffsets if not null, for each map it receives the offset just past the end of its start tag
+  */
+QList<QMap<QString, QString> >
+SimpleXmlParser::getTagsProperties(const QString &i_msg, const TagQuery &i_tag, QList<int> *endOffsets)
 {
     QList<QMap<QString, QString> >maplist;
+    const int tagLen = i_tag.m_startTag.length();
 
-    int idx,last=0;
-    QString ntag = i_tag;
-    ntag.remove(QRegularExpression("[<>]"));
-    QRegularExpression rx("<" + ntag + "[\\s*|>]");
-    int numtags = i_msg.count(rx);
-    for (int i=0; i<numtags; i++) {
+    int idx, endidx, last=0;
+    while (true) {
+        bool emptytag = findStartTagDelimiters(i_msg, i_tag, last, idx, endidx);
+        if (idx < 0 || endidx < 0)
+            break;
 #ifdef SXML_DBG
-        qDebug() << "parsing loop " << i << " idx=" << last;
+        qDebug() << "parsing loop idx=" << idx;
 #endif
-        idx = i_msg.indexOf(rx,last);
-        maplist << getTagProperties(i_msg, i_tag, idx);
+        maplist << parseProperties(i_msg, idx + tagLen, endidx - (emptytag ? 1 : 0));
+        if (endOffsets)
+            *endOffsets << endidx + 1;
         last = idx+1;
     }
 
     return maplist;
 }
 
-/********TEST FNXS *********/
 
-void
-SimpleXmlParser::test_getTag()
+
+
+/*!
+  \brief finds the next piece of markup (tag, comment, CDATA section, processing instruction...) starting from \a from
+  Quoted attribute values may contain '>', a '<' not followed by a name is treated as text.
+  \return false if there is no more complete markup in the text
+  */
+bool
+SimpleXmlParser::nextMarkup(const QChar *data, int size, int from, Markup &markup)
 {
-    QString ts1 = "<pippo>ciao</pippo>";
-    QString ts1b = "<pippo2>ciao</pippo2>";
-    QString ts2 = "<pippo/>";
-    QString ts3 = "<pippo   />";
-    QString ts4 = "<pippo  >ciao</pippo>";
-    QString ts5 = "<pippo p1='bello' >ciao</pippo>";
+    const char16_t *text = utf16(data);
+    int p = from;
+    while (true) {
+        p = SimpleXmlScan::indexOf(text, size, p, u'<');
+        if (p < 0 || p + 1 >= size)
+            return false;
 
-    QString ts6 = "<pippolist>\
-            <pippo>ciao</pippo>\n\
-            <pippo>ciao2</pippo>\
-            </pippolist>";
+        markup.begin = p;
+        QChar c = data[p + 1];
+        if (c == '!' || c == '?') {
+            const char16_t *close = u">";
+            int closeLen = 1;
+            if (c == '?') {
+                close = u"?>";
+                closeLen = 2;
+            }
+            else if (matchesAscii(data + p, size - p, "<!--")) {
+                close = u"-->";
+                closeLen = 3;
+            }
+            else if (matchesAscii(data + p, size - p, "<![CDATA[")) {
+                close = u"]]>";
+                closeLen = 3;
+            }
 
-    QString ts7 = "<pippo p1='ciao' >alice &lt; bob&#x2019;s mom &amp; '3 &gt; 1' &#233;&#224;&#8364;</pippo>";
+            int e = SimpleXmlScan::indexOf(text, size, p + 2, close, closeLen);
+            if (e < 0)
+                return false;
+            markup.kind = Markup::E_OtherMarkup;
+            markup.end = e + closeLen;
+            markup.nameBegin = markup.nameEnd = markup.attributesEnd = p + 1;
+            return true;
+        }
 
-    QString rs;
-    QStringList rsl;
+        bool endTag = (c == '/');
+        int n = p + (endTag ? 2 : 1);
+        markup.nameBegin = n;
+        while (n < size && data[n] != '>' && data[n] != '/' && !data[n].isSpace())
+            n++;
+        markup.nameEnd = n;
+        if (n == markup.nameBegin) {
+            p++;        //not a tag
+            continue;
+        }
 
-    rs = SimpleXmlParser::getTagValue(ts1, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="ciao");
-    qDebug() << "Test 1 passed\n----------\n";
+        n = findTagClose(data, size, n);
+        if (n == -2) {
+            p++;        //malformed, a '<' comes before its '>'
+            continue;
+        }
+        if (n < 0)
+            return false;
 
-    rs = SimpleXmlParser::getTagValue(ts1b, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs!="ciao");
-    qDebug() << "Test 1b passed\n----------\n";
+        markup.end = n + 1;
+        if (endTag) {
+            markup.kind = Markup::E_EndTag;
+            markup.attributesEnd = markup.nameEnd;
+        }
+        else if (data[n - 1] == '/') {
+            markup.kind = Markup::E_EmptyElementTag;
+            markup.attributesEnd = n - 1;
+        }
+        else {
+            markup.kind = Markup::E_StartTag;
+            markup.attributesEnd = n;
+        }
+        return true;
+    }
+}
 
-    rs = SimpleXmlParser::getTagValue(ts1, "<pippo>");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="ciao");
-    qDebug() << "Test 1c passed\n----------\n";
 
-    rs = SimpleXmlParser::getTagValue(ts2, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="");
-    qDebug() << "Test 2 passed\n----------\n";
 
-    rs = SimpleXmlParser::getTagValue(ts3, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="");
-    qDebug() << "Test 3 passed\n----------\n";
+/*!
+  \brief returns an iterator on the attributes of the start tag of \a i_tag, the attributes are parsed while iterating
+  */
+SimpleXmlParser::AttributeIterator
+SimpleXmlParser::getTagAttributes(const QString &i_msg, const TagQuery &i_tag, int i_offset)
+{
+    int idx, endidx;
+    bool emptytag = findStartTagDelimiters(i_msg, i_tag, i_offset, idx, endidx);
+    if (idx < 0 || endidx < 0)
+        return AttributeIterator();
+
+    const QChar *data = i_msg.constData();
+    return AttributeIterator(data + idx + i_tag.m_startTag.length(), data + endidx - (emptytag ? 1 : 0));
+}
+
+
+
+/*!
+  \brief fills \a attributes with the attributes of the start tag of \a i_tag, in the order they are written
+  Nothing is allocated as long as the tag has no more attributes than the list preallocates.
+  \return false if the tag was not found
+  */
+bool
+SimpleXmlParser::getTagAttributes(const QString &i_msg, const TagQuery &i_tag, AttributeList &attributes, int i_offset)
+{
+    attributes.clear();
+    AttributeIterator it = getTagAttributes(i_msg, i_tag, i_offset);
+    if (it.m_end == 0)
+        return false;
+
+    while (it.hasNext())
+        attributes.append(it.next());
+    return true;
+}
+
+
+
+/*!
+  \brief the raw value of \a attribute in the start tag of \a i_tag
+  \return a view inside \a i_msg, a null view if the tag or the attribute was not found
+  */
+QStringView
+SimpleXmlParser::getTagAttributeView(const QString &i_msg, const TagQuery &i_tag, const QString &attribute, int i_offset)
+{
+    AttributeIterator it = getTagAttributes(i_msg, i_tag, i_offset);
+    while (it.hasNext()) {
+        Attribute attr = it.next();
+        if (attr.name.size() == attribute.size() && memcmp(attr.name.data(), attribute.constData(), attribute.size() * sizeof(QChar)) == 0)
+            return attr.value;
+    }
+    return QStringView();
+}
+
+
+
+/*!
+  \brief copies \a text without the whitespace around it to \a out, if it is ASCII and fits in \a outSize
+  \return the number of characters copied, -1 if the text can not be a number
+  */
+static int
+numberText(QStringView text, char *out, int outSize)
+{
+    int begin = 0, end = int(text.size());
+    while (begin < end && text[begin].isSpace())
+        begin++;
+    while (end > begin && text[end - 1].isSpace())
+        end--;
+    if (end - begin > outSize)
+        return -1;
+
+    for (int i = begin; i < end; i++) {
+        ushort c = text[i].unicode();
+        if (c >= 0x80)
+            return -1;
+        out[i - begin] = char(c);
+    }
+    return end - begin;
+}
+
+
+
+template <typename T>
+static std::from_chars_result
+fromChars(const char *begin, const char *end, T &value)
+{
+    return std::from_chars(begin, end, value);
+}
+
+
+
+#if !defined(__cpp_lib_to_chars)
+/* this standard library has no floating point from_chars, QLocale::c() takes the same syntax whatever the process locale */
+static std::from_chars_result
+fromChars(const char *begin, const char *end, double &value)
+{
+    bool ok;
+    value = QLocale::c().toDouble(QString::fromLatin1(begin, int(end - begin)), &ok);
+    std::from_chars_result r = { ok ? end : begin, ok ? std::errc() : std::errc::invalid_argument };
+    return r;
+}
+#endif
+
+
+
+template <typename T>
+static SimpleXmlParser::ValueError
+parseText(QStringView text, T &value)
+{
+    char buf[64];
+    int len = numberText(text, buf, int(sizeof(buf)));
+    if (len <= 0)
+        return SimpleXmlParser::E_ValueInvalid;
+
+    //from_chars does not take the leading '+' that XML Schema allows
+    const char *begin = buf, *end = buf + len;
+    if (*begin == '+' && len > 1 && begin[1] != '-')
+        begin++;
+
+    T parsed;
+    std::from_chars_result r = fromChars(begin, end, parsed);
+    if (r.ec == std::errc::result_out_of_range)
+        return SimpleXmlParser::E_ValueOutOfRange;
+    if (r.ec != std::errc() || r.ptr != end)
+        return SimpleXmlParser::E_ValueInvalid;
+    value = parsed;
+    return SimpleXmlParser::E_ValueOk;
+}
+
+
+
+static SimpleXmlParser::ValueError
+parseText(QStringView text, bool &value)
+{
+    char buf[8];
+    int len = numberText(text, buf, int(sizeof(buf)));
+    if ((len == 4 && memcmp(buf, "true", 4) == 0) || (len == 1 && buf[0] == '1'))
+        value = true;
+    else if ((len == 5 && memcmp(buf, "false", 5) == 0) || (len == 1 && buf[0] == '0'))
+        value = false;
+    else
+        return SimpleXmlParser::E_ValueInvalid;
+    return SimpleXmlParser::E_ValueOk;
+}
+
+
+
+template <typename T>
+static T
+convertedValue(QStringView text, T defaultValue, SimpleXmlParser::ValueError *error)
+{
+    T value = defaultValue;
+    SimpleXmlParser::ValueError result = text.isNull() ? SimpleXmlParser::E_ValueNotFound : SimpleXmlParser::parseValue(text, value);
+    if (error)
+        *error = result;
+    return value;
+}
+
+
+
+/*!
+  \brief converts \a text to \a value without allocating, \a value is left untouched unless E_ValueOk is returned
+  */
+template <typename T>
+SimpleXmlParser::ValueError
+SimpleXmlParser::parseValue(QStringView text, T &value)
+{
+    return parseText(text, value);
+}
+
+
+
+/*!
+  \brief the value of \a tag converted to T, see parseValue()
+  */
+template <typename T>
+T
+SimpleXmlParser::getTagValueAs(const QString &msg, const QString &tag, int beginidx, T defaultValue, ValueError *error)
+{
+    return getTagValueAs<T>(msg, TagQuery(tag), beginidx, defaultValue, error);
+}
+
+
+
+template <typename T>
+T
+SimpleXmlParser::getTagValueAs(const QString &msg, const TagQuery &tag, int beginidx, T defaultValue, ValueError *error)
+{
+    return convertedValue(getTagValueView(msg, tag, beginidx), defaultValue, error);
+}
+
+
+
+/*!
+  \brief the value of \a attribute in the start tag of \a tag converted to T, see parseValue()
+  */
+template <typename T>
+T
+SimpleXmlParser::getTagAttributeAs(const QString &msg, const QString &tag, const QString &attribute, int beginidx, T defaultValue, ValueError *error)
+{
+    return getTagAttributeAs<T>(msg, TagQuery(tag), attribute, beginidx, defaultValue, error);
+}
+
+
+
+template <typename T>
+T
+SimpleXmlParser::getTagAttributeAs(const QString &msg, const TagQuery &tag, const QString &attribute, int beginidx, T defaultValue, ValueError *error)
+{
+    return convertedValue(getTagAttributeView(msg, tag, attribute, beginidx), defaultValue, error);
+}
+
+
+
+//the types the typed getters are built for
+#define SXML_TYPED_GETTERS(T) \
+    template SimpleXmlParser::ValueError SimpleXmlParser::parseValue<T>(QStringView, T &); \
+    template T SimpleXmlParser::getTagValueAs<T>(const QString &, const QString &, int, T, ValueError *); \
+    template T SimpleXmlParser::getTagValueAs<T>(const QString &, const TagQuery &, int, T, ValueError *); \
+    template T SimpleXmlParser::getTagAttributeAs<T>(const QString &, const QString &, const QString &, int, T, ValueError *); \
+    template T SimpleXmlParser::getTagAttributeAs<T>(const QString &, const TagQuery &, const QString &, int, T, ValueError *);
+
+SXML_TYPED_GETTERS(int)
+SXML_TYPED_GETTERS(uint)
+SXML_TYPED_GETTERS(qint64)
+SXML_TYPED_GETTERS(quint64)
+SXML_TYPED_GETTERS(double)
+SXML_TYPED_GETTERS(bool)
+
+#undef SXML_TYPED_GETTERS
+
+
+
+/*!
+  \brief prepares the lookup of \a tags, the angular brackets are stripped like TagQuery does
+  */
+SimpleXmlParser::TagSet::TagSet(const QStringList &tags)
+{
+    foreach (const QString &tag, tags) {
+        QString name = TagQuery(tag).name();
+        int first = lookup(name.constData(), name.size());
+
+        m_duplicateOf << first;
+        if (first < 0) {
+            if (m_byLength.size() <= name.size())
+                m_byLength.resize(name.size() + 1);
+            m_byLength[name.size()] << m_names.size();
+        }
+        m_names << name;
+    }
+}
+
+
+
+/*!
+  \return the index of the (first) name equal to the \a length characters at \a name, -1 if none
+  */
+int
+SimpleXmlParser::TagSet::lookup(const QChar *name, int length) const
+{
+    if (length >= m_byLength.size())
+        return -1;
+
+    foreach (int i, m_byLength.at(length)) {
+        if (memcmp(m_names.at(i).constData(), name, length * sizeof(QChar)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+
+
+/*!
+  \brief returns the values of the first occurrence of each of \a tags, found in a single scan of the message
+  The values are in the same order of \a tags, a tag that was not found (or whose end tag is missing)
+  gives a null string, an empty element an empty one. The scan stops as soon as every tag was found.
+  \param attributes if not null, it receives the attributes of each tag (an empty map for the missing ones)
+  */
+QStringList
+SimpleXmlParser::getTagSetValues(const QString &msg, const QStringList &tags, QList<QMap<QString, QString> > *attributes)
+{
+    return getTagSetValues(msg, TagSet(tags), attributes);
+}
+
+
+
+QStringList
+SimpleXmlParser::getTagSetValues(const QString &msg, const TagSet &tags, QList<QMap<QString, QString> > *attributes)
+{
+    QStringList values;
+    foreach (QStringView value, getTagSetValuesViews(msg, tags, attributes)) {
+        values << (value.isNull() ? QString() : value.toString());
+    }
+    return values;
+}
+
+
+
+/*!
+  \brief same as getTagSetValues() but the values are not copied, a missing tag gives a null view
+  */
+QVector<QStringView>
+SimpleXmlParser::getTagSetValuesViews(const QString &msg, const TagSet &tags, QList<QMap<QString, QString> > *attributes)
+{
+    enum State { E_NotFound, E_Open, E_Found };
+
+    const int count = tags.count();
+    const QChar *data = msg.constData();
+    const int size = msg.size();
+
+    QVector<QStringView> values(count);
+    QVarLengthArray<State, 32> state(count);
+    QVarLengthArray<int, 32> contentBegin(count);
+    for (int i = 0; i < count; i++)
+        state[i] = E_NotFound;
+    if (attributes) {
+        attributes->clear();
+        for (int i = 0; i < count; i++)
+            *attributes << QMap<QString, QString>();
+    }
+
+    int left = 0;       //the distinct tags whose value is still missing
+    for (int i = 0; i < count; i++) {
+        if (tags.m_duplicateOf.at(i) < 0)
+            left++;
+    }
+
+    Markup markup;
+    int pos = 0;
+    while (left > 0 && nextMarkup(data, size, pos, markup)) {
+        pos = markup.end;
+        if (markup.kind == Markup::E_OtherMarkup)
+            continue;
+
+        int i = tags.lookup(data + markup.nameBegin, markup.nameEnd - markup.nameBegin);
+        if (i < 0)
+            continue;
+
+        if (markup.kind == Markup::E_EndTag) {
+            //the first end tag closes the value, like getTagValue() does
+            if (state[i] == E_Open) {
+                values[i] = QStringView(data + contentBegin[i], markup.begin - contentBegin[i]);
+                state[i] = E_Found;
+                left--;
+            }
+            continue;
+        }
+
+        if (state[i] != E_NotFound)
+            continue;
+        if (attributes)
+            (*attributes)[i] = parseProperties(msg, markup.nameEnd, markup.attributesEnd);
+        if (markup.kind == Markup::E_EmptyElementTag) {
+            values[i] = QStringView(data + markup.end, 0);
+            state[i] = E_Found;
+            left--;
+        }
+        else {
+            contentBegin[i] = markup.end;
+            state[i] = E_Open;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        int first = tags.m_duplicateOf.at(i);
+        if (first >= 0) {
+            values[i] = values.at(first);
+            if (attributes)
+                (*attributes)[i] = attributes->at(first);
+        }
+    }
+
+    return values;
+}
+
+
+
+/*!
+  \brief compiles \a path, a '/' inside a quoted predicate value does not split the steps
+  */
+SimpleXmlParser::PathQuery::PathQuery(const QString &path)
+    : m_absolute(path.startsWith('/')),
+      m_valid(true)
+{
+    QString step;
+    QChar quote;
+    foreach (QChar c, path) {
+        if (!quote.isNull()) {
+            if (c == quote)
+                quote = QChar();
+        }
+        else if (c == '\'' || c == '"') {
+            quote = c;
+        }
+        else if (c == '/') {
+            if (!step.isEmpty() && !parseStep(step))
+                return;
+            step.clear();
+            continue;
+        }
+        step.append(c);
+    }
+    if (!quote.isNull() || (!step.isEmpty() && !parseStep(step)) || m_steps.isEmpty())
+        m_valid = false;
+}
+
+
+
+/*!
+  \brief parses a step like "name[@attr='value'][@other]" and appends it to the path
+  */
+bool
+SimpleXmlParser::PathQuery::parseStep(const QString &step)
+{
+    Step st;
+    int p = step.indexOf('[');
+    st.name = step.left(p < 0 ? step.size() : p).trimmed();
+    if (st.name == "*")
+        st.name.clear();
+    else if (st.name.isEmpty())
+        m_valid = false;
+
+    while (m_valid && p >= 0 && p < step.size()) {
+        //p is on a '[', the only predicates supported are [@attr] and [@attr='value']
+        int close = step.indexOf(']', p);
+        int eq = step.indexOf('=', p);
+        if (p + 1 >= step.size() || step.at(p + 1) != '@' || close < 0) {
+            m_valid = false;
+            break;
+        }
+        Predicate pred;
+        pred.hasValue = (eq >= 0 && eq < close);
+        pred.attribute = step.mid(p + 2, (pred.hasValue ? eq : close) - (p + 2)).trimmed();
+        if (pred.hasValue) {
+            int q = eq + 1;
+            while (q < step.size() && step.at(q).isSpace())
+                q++;
+            QChar quote = q < step.size() ? step.at(q) : QChar();
+            int qend = (quote == '\'' || quote == '"') ? step.indexOf(quote, q + 1) : -1;
+            if (qend < 0) {
+                m_valid = false;
+                break;
+            }
+            pred.value = step.mid(q + 1, qend - q - 1);
+            close = step.indexOf(']', qend);
+            if (close < 0) {
+                m_valid = false;
+                break;
+            }
+        }
+        if (pred.attribute.isEmpty()) {
+            m_valid = false;
+            break;
+        }
+        st.predicates << pred;
+
+        p = close + 1;
+        while (p < step.size() && step.at(p).isSpace())
+            p++;
+        if (p < step.size() && step.at(p) != '[')
+            m_valid = false;
+    }
+
+    if (m_valid)
+        m_steps << st;
+    return m_valid;
+}
+
+
+
+/*!
+  \brief checks the name and the attributes of the start tag in \a markup against \a step
+  */
+bool
+SimpleXmlParser::stepMatches(const QChar *data, const Markup &markup, const PathQuery::Step &step)
+{
+    const int nameLength = markup.nameEnd - markup.nameBegin;
+    if (!step.name.isEmpty() && (step.name.size() != nameLength
+                                 || memcmp(step.name.constData(), data + markup.nameBegin, nameLength * sizeof(QChar)) != 0))
+        return false;
+
+    foreach (const PathQuery::Predicate &pred, step.predicates) {
+        bool found = false;
+        AttributeIterator it(data + markup.nameEnd, data + markup.attributesEnd);
+        while (!found && it.hasNext()) {
+            Attribute attr = it.next();
+            found = attr.name == QStringView(pred.attribute) && (!pred.hasValue || attr.value == QStringView(pred.value));
+        }
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+
+
+/*!
+  \brief returns the raw values of all the elements matching \a path, in document order
+  */
+QStringList
+SimpleXmlParser::select(const QString &msg, const QString &path)
+{
+    return select(msg, PathQuery(path));
+}
+
+
+
+QStringList
+SimpleXmlParser::select(const QString &msg, const PathQuery &path)
+{
+    QStringList values;
+    foreach (QStringView value, selectViews(msg, path)) {
+        values << value.toString();
+    }
+    return values;
+}
+
+
+
+/*!
+  \brief same as select() but the values are not copied
+  The message is scanned once keeping the stack of the open elements, each one remembers whether it
+  matches the path up to its depth so the children are checked against the next step only.
+  */
+QVector<QStringView>
+SimpleXmlParser::selectViews(const QString &msg, const PathQuery &path)
+{
+    struct OpenElement
+    {
+        int nameBegin, nameLength;
+        int contentBegin;
+        bool matched;
+    };
+
+    QVector<QStringView> found;
+    if (!path.m_valid)
+        return found;
+
+    const QChar *data = msg.constData();
+    const int size = msg.size();
+    const int base = path.m_absolute ? 0 : 1;   //the depth of the elements checked against the first step
+    const int last = path.m_steps.size() - 1;
+    QVarLengthArray<OpenElement, 32> open;
+
+    Markup markup;
+    int pos = 0;
+    while (nextMarkup(data, size, pos, markup)) {
+        pos = markup.end;
+
+        if (markup.kind == Markup::E_StartTag || markup.kind == Markup::E_EmptyElementTag) {
+            const int step = open.size() - base;
+            bool matched = step >= 0 && step <= last
+                    && (step == 0 || open.last().matched)
+                    && stepMatches(data, markup, path.m_steps.at(step));
+            if (matched && step == last && markup.kind == Markup::E_EmptyElementTag)
+                found << QStringView(data + markup.end, 0);
+            if (markup.kind == Markup::E_StartTag) {
+                OpenElement el = { markup.nameBegin, markup.nameEnd - markup.nameBegin, markup.end, matched };
+                open.append(el);
+            }
+        }
+        else if (markup.kind == Markup::E_EndTag) {
+            //close the innermost element with the same name, the ones left open inside it are dropped
+            const int nameLength = markup.nameEnd - markup.nameBegin;
+            int i = open.size() - 1;
+            while (i >= 0 && (open[i].nameLength != nameLength
+                              || memcmp(data + open[i].nameBegin, data + markup.nameBegin, nameLength * sizeof(QChar)) != 0))
+                i--;
+            if (i < 0)
+                continue;       //stray end tag
+            if (open[i].matched && i - base == last)
+                found << QStringView(data + open[i].contentBegin, markup.begin - open[i].contentBegin);
+            open.resize(i);
+        }
+    }
+
+    return found;
+}
+
+
+
+SimpleXmlParser::AttributeIterator::AttributeIterator(const QChar *begin, const QChar *end)
+    : m_pos(begin),
+      m_end(end),
+      m_hasNext(false)
+{
+    advance();
+}
+
+
+
+SimpleXmlParser::Attribute
+SimpleXmlParser::AttributeIterator::next()
+{
+    Attribute current = m_next;
+    advance();
+    return current;
+}
+
+
+
+/*!
+  \brief the attribute tokenizer, a state machine walking the start tag text once
+  Names end at a space or '='. Values are quoted with either quote, and can then hold spaces, '=', '>' or
+  the other quote, or unquoted up to the next space. Attributes without a value and stray '=' are skipped.
+  */
+void
+SimpleXmlParser::AttributeIterator::advance()
+{
+    enum State { E_BeforeName, E_Name, E_AfterName, E_BeforeValue, E_UnquotedValue };
+
+    State state = E_BeforeName;
+    const QChar *name = 0, *nameEnd = 0, *value = 0;
+    m_hasNext = false;
+
+    for (; m_pos < m_end; m_pos++) {
+        const QChar c = *m_pos;
+        switch (state) {
+        case E_BeforeName:
+            if (!c.isSpace() && c != '=') {
+                name = m_pos;
+                state = E_Name;
+            }
+            break;
+        case E_Name:
+            if (c == '=' || c.isSpace()) {
+                nameEnd = m_pos;
+                state = (c == '=') ? E_BeforeValue : E_AfterName;
+            }
+            break;
+        case E_AfterName:
+            if (c == '=') {
+                state = E_BeforeValue;
+            }
+            else if (!c.isSpace()) {
+                name = m_pos;       //the previous attribute has no value, this is the next one
+                state = E_Name;
+            }
+            break;
+        case E_BeforeValue:
+            if (c == '"' || c == '\'') {
+                //jump to the closing quote
+                value = m_pos + 1;
+                int len = SimpleXmlScan::indexOf(utf16(value), int(m_end - value), 0, c.unicode());
+                if (len < 0) {
+                    m_pos = m_end;  //unterminated value, the tag is malformed
+                    return;
+                }
+                m_next.name = QStringView(name, nameEnd - name);
+                m_next.value = QStringView(value, len);
+                m_pos = value + len + 1;
+                m_hasNext = true;
+                return;
+            }
+            if (!c.isSpace()) {
+                value = m_pos;
+                state = E_UnquotedValue;
+            }
+            break;
+        case E_UnquotedValue:
+            if (c.isSpace()) {
+                m_next.name = QStringView(name, nameEnd - name);
+                m_next.value = QStringView(value, m_pos - value);
+                m_hasNext = true;
+                return;
+            }
+            break;
+        }
+    }
+
+    if (state == E_UnquotedValue) {
+        m_next.name = QStringView(name, nameEnd - name);
+        m_next.value = QStringView(value, m_end - value);
+        m_hasNext = true;
+    }
+}
+
+/********TEST FNXS *********/
+
+void
+SimpleXmlParser::test_getTag()
+{
+    QString ts1 = "<pippo>ciao</pippo>";
+    QString ts1b = "<pippo2>ciao</pippo2>";
+    QString ts2 = "<pippo/>";
+    QString ts3 = "<pippo   />";
+    QString ts4 = "<pippo  >ciao</pippo>";
+    QString ts5 = "<pippo p1='bello' >ciao</pippo>";
+
+    QString ts6 = "<pippolist>\
+            <pippo>ciao</pippo>\n\
+            <pippo>ciao2</pippo>\
+            </pippolist>";
+
+    QString ts7 = "<pippo p1='ciao' >alice &lt; bob&#x2019;s mom &amp; '3 &gt; 1' &#233;&#224;&#8364;</pippo>";
+
+    QString rs;
+    QStringList rsl;
+
+    rs = SimpleXmlParser::getTagValue(ts1, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="ciao");
+    qDebug() << "Test 1 passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts1b, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs!="ciao");
+    qDebug() << "Test 1b passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts1, "<pippo>");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="ciao");
+    qDebug() << "Test 1c passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts2, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="");
+    qDebug() << "Test 2 passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts3, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="");
+    qDebug() << "Test 3 passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts4, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="ciao");
+    qDebug() << "Test 4 passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts5, "pippo");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="ciao");
+    qDebug() << "Test 5 passed\n----------\n";
+
+    rsl = SimpleXmlParser::getTagsValues(ts6, "pippo");
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl.size()==2);
+    Q_ASSERT(rsl.at(0)=="ciao");
+    Q_ASSERT(rsl.at(1)=="ciao2");
+    qDebug() << "Test 6 passed\n----------\n";
+
+    rsl = SimpleXmlParser::getTagsValues(ts6, "<pippo>");
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl.size()==2);
+    Q_ASSERT(rsl.at(0)=="ciao");
+    Q_ASSERT(rsl.at(1)=="ciao2");
+    qDebug() << "Test 6b passed\n----------\n";
+
+    QList<int> offsets;
+    rsl = SimpleXmlParser::getTagsValues(ts6, "pippo", &offsets);
+    qDebug() << "Result: " << rsl << offsets;
+    Q_ASSERT(rsl.size()==2);
+    Q_ASSERT(offsets.size()==2);
+    Q_ASSERT(offsets.at(0)==ts6.indexOf("</pippo>") + 8);
+    Q_ASSERT(offsets.at(1)==ts6.lastIndexOf("</pippo>") + 8);
+    qDebug() << "Test 6c passed\n----------\n";
+
+    rs = SimpleXmlParser::getTagValue(ts7, "pippo");
+    qDebug() << "Result: " << decodeEntities(rs);
+    Q_ASSERT(decodeEntities(rs)=="alice < bob’s mom & '3 > 1' éà€");
+    qDebug() << "Test 7 passed\n----------\n";
+
+    rs = decodeEntities("&amp;lt; &#x1F600;&#128512; &#X41;&#x4a; &unknown; &#xZZ; &#65 &#x110000; &" + QString(QChar(0xFFFD)) + "!");
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="&lt; 😀😀 AJ &unknown; &#xZZ; &#65 &#x110000; & !");
+    qDebug() << "Test 7b passed\n----------\n";
+
+    rs = encodeEntities("alice < bob’s mom & '3 > 1' \"è\" 😀", true);
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="alice &lt; bob&#x2019;s mom &amp; &apos;3 &gt; 1&apos; &quot;&#xe8;&quot; &#x1f600;");
+    Q_ASSERT(decodeEntities(rs)=="alice < bob’s mom & '3 > 1' \"è\" 😀");
+    Q_ASSERT(encodeEntities("è & è")=="è &amp; è");
+    rs = "<a>";
+    appendEncodedEntities(rs, "1 < 2", false);
+    Q_ASSERT(rs=="<a>1 &lt; 2");
+    qDebug() << "Test 7c passed\n----------\n";
+
+    TagQuery query("<pippo>");
+    rs = SimpleXmlParser::getTagValue(ts5, query);
+    qDebug() << "Result: " << rs;
+    Q_ASSERT(rs=="ciao");
+    rsl = SimpleXmlParser::getTagsValues(ts6, query);
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl.size()==2);
+    Q_ASSERT(rsl.at(1)=="ciao2");
+    Q_ASSERT(SimpleXmlParser::getTagValue(ts1b, query, 0, "none")=="none");
+    qDebug() << "Test 8 passed\n----------\n";
+
+    QStringView rv = SimpleXmlParser::getTagValueView(ts5, query);
+    qDebug() << "Result: " << rv.toString();
+    Q_ASSERT(rv.toString()=="ciao");
+    Q_ASSERT(rv.data() > ts5.constData() && rv.data() < ts5.constData() + ts5.size());
+    Q_ASSERT(SimpleXmlParser::getTagValueView(ts3, query).isEmpty());
+    Q_ASSERT(!SimpleXmlParser::getTagValueView(ts3, query).isNull());
+    Q_ASSERT(SimpleXmlParser::getTagValueView(ts1b, query).isNull());
+    QVector<QStringView> rvl = SimpleXmlParser::getTagsValuesViews(ts6, query);
+    Q_ASSERT(rvl.size()==2);
+    Q_ASSERT(rvl.at(0).toString()=="ciao");
+    Q_ASSERT(rvl.at(1).toString()=="ciao2");
+    qDebug() << "Test 9 passed\n----------\n";
+
+    QString ts10 = "<?xml version='1.0'?><TestPlan><TestData/><TPID>76</TPID><!-- <TestData><TestID>0</TestID></TestData> -->\
+            <PhaseList>\
+            <Phase phid=\"1\"><Test><TestList>\
+            <TestData><TestID>1</TestID></TestData><TestData><TestID>2</TestID></TestData>\
+            </TestList></Test></Phase>\
+            <Phase phid='2' note=\"a/b\"><Test><TestList>\
+            <TestData><TestID>3</TestID></TestData><TestData><TestID/></TestData>\
+            </TestList></Test></Phase>\
+            </PhaseList></TestPlan>";
+    rsl = SimpleXmlParser::select(ts10, "PhaseList/Phase/Test/TestList/TestData/TestID");
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl == (QStringList() << "1" << "2" << "3" << ""));
+    rsl = SimpleXmlParser::select(ts10, "PhaseList/Phase[@phid='1']/Test/TestList/TestData/TestID");
+    Q_ASSERT(rsl == (QStringList() << "1" << "2"));
+    rsl = SimpleXmlParser::select(ts10, "PhaseList/Phase[@phid=\"2\"][@note='a/b']/*/TestList/TestData/TestID");
+    Q_ASSERT(rsl == (QStringList() << "3" << ""));
+    Q_ASSERT(SimpleXmlParser::select(ts10, "TestData").size() == 1);            //only the one right under the root
+    Q_ASSERT(SimpleXmlParser::select(ts10, "/TestPlan/TPID") == QStringList("76"));
+    Q_ASSERT(SimpleXmlParser::select(ts10, "PhaseList/Phase[@missing]").isEmpty());
+    Q_ASSERT(SimpleXmlParser::select(ts10, "PhaseList/Phase[@phid]").size() == 2);
+    Q_ASSERT(!PathQuery("PhaseList/Phase[phid='1']").isValid());
+    Q_ASSERT(!PathQuery("PhaseList/Phase[@phid='1]").isValid());
+    Q_ASSERT(!PathQuery("").isValid());
+    Q_ASSERT(SimpleXmlParser::select(ts10, "PhaseList/Phase[phid='1']").isEmpty());
+    qDebug() << "Test 10 passed\n----------\n";
+
+    TagSet fields(QStringList() << "TPID" << "<VlanId>" << "RepeatMode" << "Phase" << "Missing" << "TPID" << "TestData");
+    QList<QMap<QString, QString> > fieldAttributes;
+    rsl = SimpleXmlParser::getTagSetValues(ts10, fields, &fieldAttributes);
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl.size() == 7);
+    Q_ASSERT(rsl.at(0) == "76" && rsl.at(5) == "76");
+    Q_ASSERT(rsl.at(1).isNull() && rsl.at(4).isNull());
+    Q_ASSERT(rsl.at(3) == SimpleXmlParser::getTagValue(ts10, "Phase"));
+    Q_ASSERT(fieldAttributes.at(3).value("phid") == "1");
+    Q_ASSERT(!rsl.at(6).isNull() && rsl.at(6).isEmpty());  //the empty <TestData/> comes first
+    Q_ASSERT(fields.indexOf("VlanId") == 1);
+    rsl = SimpleXmlParser::getTagSetValues("<TestPlan><TPID>76</TPID><VlanId>1</VlanId><RepeatMode>0</RepeatMode></TestPlan>",
+                                           QStringList() << "TPID" << "VlanId" << "RepeatMode" << "LastPhaseDelay");
+    Q_ASSERT(rsl == (QStringList() << "76" << "1" << "0" << QString()));
+    qDebug() << "Test 11 passed\n----------\n";
+
+    //a start tag with an unterminated quote is malformed, the getters go on with the next tag as the framer does
+    QString ts12 = "<m><a x=\"1><a>2</a><b y='3>4</b></m>";
+    rs = SimpleXmlParser::getTagValue(ts12, "a");
+    rsl = SimpleXmlParser::getTagSetValues(ts12, QStringList() << "a" << "b");
+    qDebug() << "Result: " << rs << rsl;
+    Q_ASSERT(rs == "2");
+    Q_ASSERT(rsl == (QStringList() << "2" << QString()));
+    Q_ASSERT(SimpleXmlParser::getTagValue(ts12, "b").isEmpty());
+    Q_ASSERT(SimpleXmlParser::select(ts12, "a") == QStringList("2"));
+    qDebug() << "Test 12 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_getProperty()
+{
+    QString ts1 = "<pippo p1='bello' >ciao</pippo>";
+    QString ts2 = "<pippo p1  =  'bello  sguardo' >ciao</pippo>";
+    QString ts3 = "<pippo p1=\"bello 'sguardo' \" p2='ciccio'>ciao</pippo>";
+    QString ts4 = "<pippolist> <pippo p1=\"bello 'sguardo' \" p2='ciccio'>ciao</pippo><pippo p1=\"bello 'sguardo' \" p3='ciccio2'>ciao</pippo></pippolist>";
+
+    QString ts5 = "<TrapList>\
+            <trap\
+            eventType='userInput'\
+            networkType='eth'\
+            isAlice='true'\
+            userName='mario.rossi@gmail.com'\
+            fwVersion='13.16.00'\
+            raVersion='01.11.00'\
+            loVersion='027.072.000'\
+            timestamp='2013/06/07_14:45:13'>\
+            <body\
+            eventName='PLAY'\
+            videoUrl='http%3A%2F%2Fctv.alice.cdn.interbusiness.it%2FDAM%2FV1%2FFilm%2F2012%2F05%2FRA3_50266398.wmv%7CCOMPONENT%3DWMDRM'\
+            videoTitle='Il Gladiatore'\
+            />\
+            </trap>\
+            </TrapList>";
+
+    QString ts6 = "<pippo p1=\"alice &lt; bob&#x2019;s mom &amp; '3 &gt; 1'\" p2='&#233;&#224;&#8364;'>ciao</pippo>";
+
+    QMultiMap<QString, QString>* rm;
+    QMultiMap<QString, QString>* rm2;
+    QList<QMap<QString, QString> >rmlist;
+
+    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts1, "pippo"));
+    qDebug() << "Result: " << *rm;
+    Q_ASSERT(rm->contains("p1"));
+    Q_ASSERT(rm->value("p1")=="bello");
+    qDebug() << "Test 1 passed\n----------\n";
+    delete rm;
+
+    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts2, "pippo"));
+    qDebug() << "Result: " << *rm;
+    Q_ASSERT(rm->contains("p1"));
+    Q_ASSERT(rm->value("p1")=="bello  sguardo");
+    qDebug() << "Test 2 passed\n----------\n";
+    delete rm;
+
+    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts3, "pippo"));
+    qDebug() << "Result: " << *rm;
+    Q_ASSERT(rm->contains("p1"));
+    Q_ASSERT(rm->value("p1")=="bello 'sguardo' ");
+    Q_ASSERT(rm->contains("p2"));
+    Q_ASSERT(rm->value("p2")=="ciccio");
+    qDebug() << "Test 3 passed\n----------\n";
+    delete rm;
+
+    rmlist = SimpleXmlParser::getTagsProperties(ts4, "pippo");
+    qDebug() << "Result0: " << rmlist.at(0);
+    Q_ASSERT(rmlist.at(0).contains("p1"));
+    Q_ASSERT(rmlist.at(0)["p1"]=="bello 'sguardo' ");
+    Q_ASSERT(rmlist.at(0).contains("p2"));
+    Q_ASSERT(rmlist.at(0)["p2"]=="ciccio");
+    qDebug() << "Result1: " << rmlist.at(1);
+    Q_ASSERT(rmlist.at(1).contains("p1"));
+    Q_ASSERT(rmlist.at(1)["p1"]=="bello 'sguardo' ");
+    Q_ASSERT(rmlist.at(1).contains("p3"));
+    Q_ASSERT(rmlist.at(1)["p3"]=="ciccio2");
+    qDebug() << "Test 4 passed\n----------\n";
+
+    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts5, "trap"));
+    rm2 = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts5, "body"));
+    rm->unite(*rm2);
+    qDebug() << "Result: " << *rm;
+    Q_ASSERT(rm->contains("eventType"));
+    Q_ASSERT(rm->value("eventType")=="userInput");
+    Q_ASSERT(rm->contains("networkType"));
+    Q_ASSERT(rm->value("networkType")=="eth");
+    Q_ASSERT(rm->contains("eventName"));
+    Q_ASSERT(rm->value("eventName")=="PLAY");
+    qDebug() << "Test 5 passed\n----------\n";
+    delete rm2;
+    delete rm;
+
+    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts6, "pippo"));
+    qDebug() << "Result: " << *rm;
+    Q_ASSERT(rm->contains("p1"));
+    Q_ASSERT(decodeEntities(rm->value("p1"))=="alice < bob’s mom & '3 > 1'");
+    Q_ASSERT(rm->contains("p2"));
+    Q_ASSERT(decodeEntities(rm->value("p2"))=="éà€");
+    qDebug() << "Test 6 passed\n----------\n";
+    delete rm;
+
+    QString ts7 = "<pippo a = \"x=1\" b='y' c=z  d />";
+    QStringList names, values;
+    AttributeIterator it = SimpleXmlParser::getTagAttributes(ts7, TagQuery("pippo"));
+    while (it.hasNext()) {
+        Attribute attr = it.next();
+        names << attr.name.toString();
+        values << attr.value.toString();
+    }
+    qDebug() << "Result: " << names << values;
+    Q_ASSERT(names == (QStringList() << "a" << "b" << "c"));
+    Q_ASSERT(values == (QStringList() << "x=1" << "y" << "z"));
+    qDebug() << "Test 7 passed\n----------\n";
+
+    QString ts8 = "<pippo url=\"http://h/?a=1&amp;b=2\" p1=\"x\" p2=\"y\"\tq='say \"hi\" > ok' flag/>";
+    QMap<QString, QString> props = SimpleXmlParser::getTagProperties(ts8, "pippo");
+    qDebug() << "Result: " << props;
+    Q_ASSERT(props.size() == 4);
+    Q_ASSERT(props.value("url") == "http://h/?a=1&amp;b=2");
+    Q_ASSERT(props.value("p1") == "x");
+    Q_ASSERT(props.value("p2") == "y");
+    Q_ASSERT(props.value("q") == "say \"hi\" > ok");
+    AttributeList attrs;
+    bool found = SimpleXmlParser::getTagAttributes(ts8, TagQuery("pippo"), attrs);
+    Q_ASSERT(found && attrs.size() == 4);
+    Q_ASSERT(attrs.at(0).name.toString() == "url" && attrs.at(3).name.toString() == "q");
+    found = SimpleXmlParser::getTagAttributes(ts8, TagQuery("pluto"), attrs);
+    Q_ASSERT(!found && attrs.isEmpty());
+    qDebug() << "Test 8 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_addData()
+{
+    /* Note: I'm using decodeEntities() to add unicode text to QString
+     * irrespective of IDE/System encoding (GS)
+     */
+    QString tsPart1 = SimpleXmlParser::decodeEntities("<pippo>alice &lt; bob&#x2019;s mom &amp; '3 ");
+    QString tsPart2 = SimpleXmlParser::decodeEntities("&gt; 1' &#233;&#224;&#8364;&#xc29f;</pippo>");
+
+    SimpleXmlParser xmlParser;
+    xmlParser.setStartTag("pippo");
+    xmlParser.addData(tsPart1);
+    xmlParser.addData(tsPart2);
+
+    QString rs;
+    if (xmlParser.hasPendingMessages())
+    {
+        rs = xmlParser.getNextMessage();
+    }
+    qDebug() << "Result: " << decodeEntities(rs);
+    Q_ASSERT(rs == (tsPart1 + tsPart2));
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //many messages in one chunk, start and end tags split across chunks, junk and stray end tags in between
+    QString ts2 = "junk</pippo><pippo>1</pippo><pippo>2</pippo>xx<pi";
+    QString ts3 = "ppo>3</pip";
+    QString ts4 = "po><pippo>4</pippo>";
+
+    xmlParser.addData(ts2);
+    xmlParser.addData(ts3);
+    xmlParser.addData(ts4);
+
+    QStringList rsl;
+    while (xmlParser.hasPendingMessages()) {
+        rsl << xmlParser.getNextMessage();
+    }
+    qDebug() << "Result: " << rsl;
+    Q_ASSERT(rsl.size() == 4);
+    Q_ASSERT(rsl.at(0) == "<pippo>1</pippo>");
+    Q_ASSERT(rsl.at(2) == "<pippo>3</pippo>");
+    Q_ASSERT(rsl.at(3) == "<pippo>4</pippo>");
+    Q_ASSERT(xmlParser.getCurrentBuffer().isEmpty());
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //the tags to find are signalled while the message is still arriving, even one character at a time
+    SimpleXmlParser streamParser;
+    streamParser.setStartTag("TestPlan");
+    streamParser.addTagToFind("TPID");
+    streamParser.addTagToFind("<TestID>");
+    streamParser.addTagToFind("Note");
+    streamParser.addTagToFind("TestIDs");
+    QStringList events;
+    connect(&streamParser, &SimpleXmlParser::foundTag, [&events](QString tag, QString value) {
+        events << tag + "=" + value;
+    });
+    connect(&streamParser, &SimpleXmlParser::messageCompleted, [&events]() {
+        events << "message";
+    });
+
+    QString ts5 = "<TPID>0</TPID><TestPlan><TPID>76</TPID><Note a='x>y'/><TestList><TestData><TestID>1</TestID></TestData>"
+                  "<TestData><TestID>2</TestID></TestData></TestList></TestPlan><TestPlan><TestID>3</TestID></TestPlan>";
+    int firstTestId = ts5.indexOf("</TestID>") + 9;
+    for (int i = 0; i < firstTestId; i++) {
+        streamParser.addData(ts5.mid(i, 1));
+    }
+    qDebug() << "Result: " << events;
+    Q_ASSERT(events == (QStringList() << "TPID=76" << "Note=" << "TestID=1"));
+    streamParser.addData(ts5.mid(firstTestId));
+    qDebug() << "Result: " << events;
+    Q_ASSERT(events == (QStringList() << "TPID=76" << "Note=" << "TestID=1" << "TestID=2" << "message" << "TestID=3" << "message"));
+    qDebug() << "Test 3 passed\n----------\n";
+
+    //a full queue rejects (the default) or drops the oldest messages according to the policy, reporting each one
+    SimpleXmlParser queueParser;
+    queueParser.setStartTag("pippo");
+    queueParser.setQueueCapacity(2);
+    Q_ASSERT(queueParser.getQueueFullPolicy() == E_QueueReject);
+    int queueErrors = 0;
+    connect(&queueParser, &SimpleXmlParser::parseErrorFound, [&queueErrors](ParseErrorEnumType error) {
+        if (error == E_QueueFull)
+            queueErrors++;
+    });
+    queueParser.addData("<pippo>1</pippo><pippo>2</pippo><pippo>3</pippo>");
+    rsl = queueParser.takeMessages();
+    qDebug() << "Result: " << rsl << queueErrors;
+    Q_ASSERT(queueParser.getQueueCapacity() == 2);
+    Q_ASSERT(queueErrors == 1);
+    Q_ASSERT(rsl == (QStringList() << "<pippo>1</pippo>" << "<pippo>2</pippo>"));
+
+    queueParser.setQueueFullPolicy(E_QueueDropOldest);
+    queueParser.addData("<pippo>4</pippo><pippo>5</pippo><pippo>6</pippo>");
+    rsl = queueParser.takeMessages(1);
+    rsl << queueParser.takeMessages(5);
+    qDebug() << "Result: " << rsl << queueErrors;
+    Q_ASSERT(queueErrors == 2);
+    Q_ASSERT(rsl == (QStringList() << "<pippo>5</pippo>" << "<pippo>6</pippo>"));
+    Q_ASSERT(!queueParser.hasPendingMessages());
+
+    //one thread feeding data with a blocking queue, two threads taking the messages
+    const int messageCount = 5000;
+    queueParser.setQueueCapacity(16);
+    queueParser.setQueueFullPolicy(E_QueueBlock);
+    std::atomic<int> taken(0);
+    std::atomic<bool> producing(true);
+    auto consumer = [&queueParser, &taken, &producing]() {
+        while (true) {
+            bool wasProducing = producing.load();
+            int n = queueParser.takeMessages(4).size();
+            taken += n;
+            if (n == 0) {
+                if (!wasProducing)
+                    break;
+                QThread::yieldCurrentThread();
+            }
+        }
+    };
+    std::thread consumer1(consumer);
+    std::thread consumer2(consumer);
+    for (int i = 0; i < messageCount; i++) {
+        queueParser.addData(QString("<pippo>%1</pippo>").arg(i));
+    }
+    producing = false;
+    consumer1.join();
+    consumer2.join();
+    qDebug() << "Result: " << taken.load();
+    Q_ASSERT(taken.load() == messageCount);
+    Q_ASSERT(queueErrors == 2);
+    qDebug() << "Test 4 passed\n----------\n";
+
+    //in batch mode the messages completed by a chunk are emitted together, once per chunk or per window
+    SimpleXmlParser batchParser;
+    batchParser.setStartTag("pippo");
+    batchParser.setNotificationMode(E_DispatchBatch);
+    QList<QStringList> batches;
+    connect(&batchParser, &SimpleXmlParser::parsedMessages, [&batches](QStringList msgs) {
+        batches << msgs;
+    });
+    batchParser.addData("<pippo>1</pippo><pippo>2</pippo><pippo>3</pi");
+    batchParser.addData("ppo>");
+    batchParser.addData("<pippo>4");
+    qDebug() << "Result: " << batches;
+    Q_ASSERT(batches.size() == 2);
+    Q_ASSERT(batches.at(0).size() == 2 && batches.at(1) == (QStringList() << "<pippo>3</pippo>"));
+    Q_ASSERT(!batchParser.hasPendingMessages());
+
+    batches.clear();
+    batchParser.emptyBuffer();
+    batchParser.setBatchWindow(0, 2);
+    batchParser.addData("<pippo>1</pippo><pippo>2</pippo><pippo>3</pippo><pippo>4</pippo><pippo>5</pippo>");
+    qDebug() << "Result: " << batches;
+    Q_ASSERT(batches.size() == 3 && batches.at(0).size() == 2 && batches.at(2).size() == 1);
+
+    batches.clear();
+    batchParser.setBatchWindow(20);
+    batchParser.addData("<pippo>1</pippo>");
+    batchParser.addData("<pippo>2</pippo><pippo>3</pippo>");
+    Q_ASSERT(batches.isEmpty());
+    QEventLoop loop;
+    QTimer::singleShot(100, &loop, &QEventLoop::quit);
+    loop.exec();
+    qDebug() << "Result: " << batches;
+    Q_ASSERT(batches.size() == 1 && batches.at(0).size() == 3);
+    batchParser.addData("<pippo>4</pippo>");
+    batchParser.flushBatch();
+    Q_ASSERT(batches.size() == 2 && batches.at(1) == (QStringList() << "<pippo>4</pippo>"));
+    qDebug() << "Test 5 passed\n----------\n";
+
+    //UTF-8 data is framed on the bytes, a multibyte character or a tag may be split across chunks
+    SimpleXmlParser utf8Parser;
+    utf8Parser.setStartTag("pippo");
+    QString citta = decodeEntities("citt&#224;");
+    utf8Parser.addTagToFind(citta);
+    QStringList utf8Events;
+    connect(&utf8Parser, &SimpleXmlParser::foundTag, [&utf8Events](QString tag, QString value) {
+        utf8Events << tag + "=" + value;
+    });
+    QString ts6Message = decodeEntities("<pippo><citt&#224; a='>'>&#8364; 3</citt&#224;>x</pippo>");
+    QByteArray ts6 = ("junk" + ts6Message + "<pippo>2</pippo><pi").toUtf8();
+    int euro = ts6.indexOf("\xe2\x82\xac");
+    utf8Parser.addUtf8Data(ts6.left(euro + 1));
+    utf8Parser.addUtf8Data(ts6.constData() + euro + 1, ts6.size() - euro - 1);
+    utf8Parser.addUtf8Data(QByteArray("ppo>\xc3\xa9</pippo>"));
+    QList<QByteArray> utf8Messages = utf8Parser.takeMessagesUtf8(2);
+    qDebug() << "Result: " << utf8Events << utf8Messages;
+    Q_ASSERT(utf8Events == (QStringList() << citta + decodeEntities("=&#8364; 3")));
+    Q_ASSERT(utf8Messages.size() == 2);
+    Q_ASSERT(utf8Messages.at(0) == ts6Message.toUtf8());
+    Q_ASSERT(utf8Messages.at(1) == "<pippo>2</pippo>");
+    QString lastMessage = utf8Parser.getNextMessage();
+    Q_ASSERT(lastMessage == decodeEntities("<pippo>&#233;</pippo>"));
+    Q_ASSERT(utf8Parser.getCurrentBufferUtf8().isEmpty());
+
+    //the messages are dispatched as they were fed and the buffer limit is in bytes
+    QList<QByteArray> dispatched;
+    connect(&utf8Parser, &SimpleXmlParser::parsedMessageUtf8, [&dispatched](QByteArray msg) {
+        dispatched << msg;
+    });
+    utf8Parser.setNotificationMode(E_DispatchMessageAndDelete);
+    utf8Parser.setMaxBufferSize(8);
+    int tooBig = 0;
+    connect(&utf8Parser, &SimpleXmlParser::parseErrorFound, [&tooBig](ParseErrorEnumType error) {
+        if (error == E_MessageTooBig)
+            tooBig++;
+    });
+    utf8Parser.addUtf8Data("<pippo>1", 8);
+    utf8Parser.addUtf8Data("</pippo>", 8);
+    utf8Parser.addUtf8Data("<pippo>12", 9);
+    utf8Parser.addUtf8Data("</pippo>", 8);
+    qDebug() << "Result: " << dispatched << tooBig;
+    Q_ASSERT(dispatched == (QList<QByteArray>() << "<pippo>1</pippo>"));
+    Q_ASSERT(tooBig == 1 && !utf8Parser.hasPendingMessages());
+    qDebug() << "Test 6 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_index()
+{
+    QString ts1 = "<TestPlan>\
+            <TestData/>\
+            <TPID>76</TPID>\
+            <!-- <TPID>0</TPID> -->\
+            <PhaseList>\
+            <Phase phid=\"1\" note='a > b'><Test><TestList>\
+            <TestData><TestID>1</TestID></TestData>\
+            <TestData><TestID>2</TestID></TestData>\
+            </TestList></Test></Phase>\
+            <Phase phid=\"2\"><Test><TestList>\
+            <TestData><TestID>3</TestID></TestData>\
+            </TestList></Test></Phase>\
+            </PhaseList>\
+            </TestPlan>";
+
+    SimpleXmlIndex index(ts1);
+    qDebug() << "Elements: " << index.count();
+    Q_ASSERT(index.count() == 16);
+    Q_ASSERT(index.name(index.root()).toString() == "TestPlan");
+    Q_ASSERT(index.value(index.find("TPID")).toString() == "76");
+    Q_ASSERT(index.findAll("TestData").size() == 4);
+    Q_ASSERT(index.value(index.find("TestData")).isEmpty());
+    qDebug() << "Test 1 passed\n----------\n";
+
+    int phase = index.path("PhaseList/Phase");
+    Q_ASSERT(index.attribute(phase, "phid").toString() == "1");
+    Q_ASSERT(index.attribute(phase, "note").toString() == "a > b");
+    int phase2 = index.nextSibling(phase, "Phase");
+    Q_ASSERT(index.attribute(phase2, "phid").toString() == "2");
+    Q_ASSERT(index.nextSibling(phase2, "Phase") < 0);
+    int testData = index.path("Test/TestList/TestData", phase2);
+    Q_ASSERT(index.value(index.child(testData, "TestID")).toString() == "3");
+    Q_ASSERT(index.element(testData).depth == 5);
+    Q_ASSERT(index.parent(index.parent(testData)) == index.path("Test", phase2));
+    qDebug() << "Test 2 passed\n----------\n";
+}
+
+
+
+void
+SimpleXmlParser::test_scan()
+{
+    //every vectorized kernel must give the same results of the scalar loop, at every alignment and tail length
+    QVector<char16_t> buf(300);
+    unsigned int seed = 12345;
+    for (int i = 0; i < buf.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        static const char16_t markup[] = { u'<', u'>', u'/', u'"', u'\'', u'&', u'=', u' ', u'\x2022', u'\xFFFD' };
+        buf[i] = (seed >> 16) % 8 ? char16_t(u'a' + (seed >> 20) % 26) : markup[(seed >> 20) % 10];
+    }
+
+    static const char16_t needles[] = { u'<', u'&', u'"', u'\xFFFD' };
+    const SimpleXmlScan::Kernel kernels[] = { SimpleXmlScan::E_SSE2, SimpleXmlScan::E_AVX2, SimpleXmlScan::E_NEON };
+    int checked = 0;
+    for (int k = 0; k < 3; k++) {
+        if (!SimpleXmlScan::isKernelSupported(kernels[k]))
+            continue;
+        SimpleXmlScan::FindFunction find = SimpleXmlScan::kernelFunction(kernels[k]);
+        for (int size = 0; size <= buf.size(); size += 7) {
+            for (int from = 0; from <= size; from += 3) {
+                for (int count = 1; count <= SimpleXmlScan::MaxChars; count++) {
+                    for (int n = 0; n + count <= 4; n++) {
+                        Q_ASSERT(find(buf.constData(), size, from, needles + n, count) ==
+                                 SimpleXmlScan::findFirstOfScalar(buf.constData(), size, from, needles + n, count));
+                    }
+                }
+            }
+        }
+        checked++;
+    }
+    qDebug() << "Active kernel: " << SimpleXmlScan::activeKernel() << ", kernels checked: " << checked;
+    qDebug() << "Test 1 passed\n----------\n";
+
+    QString ts2 = "<a><ab x='1'>v</ab><abc/>text &amp; more</a>";
+    Q_ASSERT(findPattern(ts2, 0, "<ab") == 3);
+    Q_ASSERT(findPattern(ts2, 4, "<ab") == 19);
+    Q_ASSERT(findPattern(ts2, 0, "</a>") == ts2.indexOf("</a>"));
+    Q_ASSERT(findPattern(ts2, 0, "</b>") < 0);
+    Q_ASSERT(findPattern(ts2, ts2.size() - 4, "</a>") == ts2.size() - 4);
+    Q_ASSERT(findPattern(ts2, ts2.size() - 3, "</a>") < 0);
+    Q_ASSERT(findChar(ts2, 0, u'&') == ts2.indexOf('&'));
+    QString plain = "no entities here";
+    Q_ASSERT(decodeEntities(plain).constData() == plain.constData());   //returned without copying
+    qDebug() << "Test 2 passed\n----------\n";
+}
+
+
+
+/*
+ *  records the events of a SimpleXmlCore as text
+ */
+template <typename Char>
+struct CoreEventLog
+{
+    typedef typename SimpleXmlCore<Char>::View View;
+
+    const SimpleXmlCore<Char> *core;
+    std::basic_string<Char> log;
+
+    void message(int, View msg)     { log.append(1, Char('[')).append(msg).append(1, Char(']'));                   }
+    void tag(int tag, View value)   { log.append(core->tagName(tag)).append(1, Char('=')).append(value).append(1, Char(';'));   }
+    void unmatchedEndTag()          { log.append(1, Char('!'));                                                     }
+};
+
+void
+SimpleXmlParser::test_core()
+{
+    //the Qt-free core alone, fed one character at a time
+    SimpleXmlCore16 core;
+    core.setStartTag(u"m");
+    int idTag = core.addTagToFind(u"id");
+    int vTag = core.addTagToFind(u"v");
+    int idAgain = core.addTagToFind(u"id");
+    Q_ASSERT(idTag == 0 && vTag == 1 && idAgain == 0);
+    CoreEventLog<char16_t> log16 = { &core, std::u16string() };
+    std::u16string ts1 = u"</m>x<m><id>1</id><v a=\"/>\"/><idx>2</idx></m><m><v>3";
+    for (size_t i = 0; i < ts1.size(); i++) {
+        core.feed(ts1.data() + i, 1, log16);
+    }
+    qDebug() << "Result: " << QString(reinterpret_cast<const QChar *>(log16.log.data()), int(log16.log.size()));
+    Q_ASSERT(log16.log == u"!id=1;v=;[<m><id>1</id><v a=\"/>\"/><idx>2</idx></m>]");
+    Q_ASSERT(core.buffer() == u"<m><v>3");
+    core.feed(u"</v></m>", 8, log16);
+    Q_ASSERT(log16.log.substr(log16.log.size() - 21) == u"v=3;[<m><v>3</v></m>]");
+    Q_ASSERT(core.bufferSize() == 0);
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //on UTF-8 the tag names are given in UTF-8 and matched on the bytes
+    SimpleXmlCoreUtf8 utf8Core;
+    utf8Core.setStartTag("m");
+    utf8Core.addTagToFind("caf\xc3\xa9");
+    CoreEventLog<char> log8 = { &utf8Core, std::string() };
+    std::string ts2 = "<m><caf\xc3\xa9>\xe2\x82\xac</caf\xc3\xa9><cafe>x</cafe></m>";
+    utf8Core.feed(ts2.data(), 9, log8);
+    utf8Core.feed(ts2.data() + 9, int(ts2.size()) - 9, log8);
+    Q_ASSERT(log8.log == "caf\xc3\xa9=\xe2\x82\xac;[" + ts2 + "]");
+    utf8Core.clear();
+    Q_ASSERT(utf8Core.bufferSize() == 0);
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //a tag to find with an unterminated quote is malformed once a '<' follows, the next tags are still found
+    SimpleXmlCore16 core3;
+    core3.setStartTag(u"m");
+    core3.addTagToFind(u"v");
+    core3.addTagToFind(u"id");
+    CoreEventLog<char16_t> log3 = { &core3, std::u16string() };
+    std::u16string ts3 = u"<m><v a=\"x><id>1</id></m>";
+    for (size_t i = 0; i < ts3.size(); i += 3) {
+        core3.feed(ts3.data() + i, int(qMin(size_t(3), ts3.size() - i)), log3);
+    }
+    Q_ASSERT(log3.log == u"id=1;[" + ts3 + u"]");
+    SimpleXmlCoreUtf8 utf8Core3;
+    utf8Core3.setStartTag("m");
+    utf8Core3.addTagToFind("v");
+    utf8Core3.addTagToFind("id");
+    CoreEventLog<char> log3Utf8 = { &utf8Core3, std::string() };
+    std::string ts3Utf8 = "<m><v a='x><id>1</id></m>";
+    for (size_t i = 0; i < ts3Utf8.size(); i += 3) {
+        utf8Core3.feed(ts3Utf8.data() + i, int(qMin(size_t(3), ts3Utf8.size() - i)), log3Utf8);
+    }
+    Q_ASSERT(log3Utf8.log == "id=1;[" + ts3Utf8 + "]");
+    qDebug() << "Test 3 passed\n----------\n";
+
+    //the same for a start tag, it must not stall the stream
+    std::u16string ts4 = u"<m a=\"x><m>1</m><m>2</m>";
+    SimpleXmlCore16 core4;
+    core4.setStartTag(u"m");
+    CoreEventLog<char16_t> log4 = { &core4, std::u16string() };
+    for (size_t i = 0; i < ts4.size(); i += 3) {
+        core4.feed(ts4.data() + i, int(qMin(size_t(3), ts4.size() - i)), log4);
+    }
+    Q_ASSERT(log4.log == u"[<m>1</m>][<m>2</m>]" && core4.bufferSize() == 0);
+    std::string ts4Utf8 = "<m a='x><m>1</m><m>2</m>";
+    SimpleXmlCoreUtf8 utf8Core4;
+    utf8Core4.setStartTag("m");
+    CoreEventLog<char> log4Utf8 = { &utf8Core4, std::string() };
+    for (size_t i = 0; i < ts4Utf8.size(); i += 3) {
+        utf8Core4.feed(ts4Utf8.data() + i, int(qMin(size_t(3), ts4Utf8.size() - i)), log4Utf8);
+    }
+    Q_ASSERT(log4Utf8.log == "[<m>1</m>][<m>2</m>]");
+    SimpleXmlParser p4;
+    p4.setStartTag("m");
+    QString qts4 = QString::fromUtf8(ts4Utf8.c_str());
+    for (int i = 0; i < qts4.size(); i += 3) {
+        p4.addData(qts4.mid(i, 3));
+    }
+    QStringList rs4 = p4.takeMessages();
+    qDebug() << "Result: " << rs4;
+    Q_ASSERT(rs4 == (QStringList() << "<m>1</m>" << "<m>2</m>"));
+    qDebug() << "Test 4 passed\n----------\n";
+
+    //with no '<' after it the tag is given up once the buffer is full, it does not grow without bound
+    SimpleXmlParser p5;
+    p5.setStartTag("m");
+    p5.setMaxBufferSize(40);
+    QString ts5 = "<m a=\"" + QString(100, 'x') + "<m>3</m>";
+    int maxBuffered = 0;
+    for (int i = 0; i < ts5.size(); i += 7) {
+        p5.addData(ts5.mid(i, 7));
+        maxBuffered = qMax(maxBuffered, p5.getCurrentBuffer().size());
+    }
+    QStringList rs5 = p5.takeMessages();
+    qDebug() << "Result: " << rs5 << maxBuffered;
+    Q_ASSERT(rs5 == (QStringList() << "<m>3</m>"));
+    Q_ASSERT(maxBuffered <= 20 + 7);
+    qDebug() << "Test 5 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_attach()
+{
+    //a QBuffer read 7 bytes at a time, reading pauses as soon as 2 messages are waiting
+    QByteArray ts1;
+    for (int i = 0; i < 10; i++) {
+        ts1 += "<m><id>" + QByteArray::number(i) + "</id></m>";
+    }
+    QBuffer buffer(&ts1);
+    buffer.open(QIODevice::ReadOnly);
+    SimpleXmlParser p1;
+    p1.setStartTag("m");
+    p1.setReadChunkSize(7);
+    p1.setQueueHighWaterMark(2);
+    p1.attach(&buffer);
+    Q_ASSERT(p1.attachedDevice() == &buffer);
+    Q_ASSERT(!p1.hasPendingMessages());     //the first read is queued
+
+    QStringList rs1;
+    int pauses = 0;
+    for (int round = 0; round < 100 && rs1.size() < 10; round++) {
+        QCoreApplication::processEvents();
+        if (p1.isReadingPaused()) {
+            Q_ASSERT(p1.m_parsedMessages.sizeHint() == 2);
+            pauses++;
+        }
+        rs1 += p1.takeMessages();
+    }
+    qDebug() << "Result: " << rs1.size() << "messages," << pauses << "pauses";
+    Q_ASSERT(rs1.size() == 10 && pauses == 5);
+    Q_ASSERT(rs1.at(0) == "<m><id>0</id></m>" && rs1.at(9) == "<m><id>9</id></m>");
+    Q_ASSERT(buffer.atEnd() && p1.getCurrentBufferUtf8().isEmpty());
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //once detached the device is not read anymore
+    buffer.seek(0);
+    p1.detach();
+    QCoreApplication::processEvents();
+    Q_ASSERT(p1.attachedDevice() == 0 && !p1.hasPendingMessages() && buffer.pos() == 0);
+    qDebug() << "Test 2 passed\n----------\n";
+
+#ifdef QT_NETWORK_LIB
+    //the server side of a local socket, written by the client in pieces that split the tags
+    QLocalServer server;
+    QLocalServer::removeServer("sxml_test_attach");
+    bool listening = server.listen("sxml_test_attach");
+    Q_ASSERT(listening);
+    QLocalSocket client;
+    client.connectToServer("sxml_test_attach");
+    bool accepted = server.waitForNewConnection(1000);
+    Q_ASSERT(accepted);
+    QLocalSocket *serverSide = server.nextPendingConnection();
+    Q_ASSERT(serverSide);
+    bool connected = client.waitForConnected(1000);
+    Q_ASSERT(connected);
+
+    SimpleXmlParser p3;
+    p3.setStartTag("m");
+    p3.setReadChunkSize(5);
+    p3.attach(serverSide);
+    QByteArray ts3 = ts1 + "<m>caf\xc3\xa9</m>";
+    for (int i = 0; i < ts3.size(); i += 13) {
+        client.write(ts3.mid(i, 13));
+        client.flush();
+    }
+
+    QStringList rs3;
+    for (int round = 0; round < 100 && rs3.size() < 11; round++) {
+        serverSide->waitForReadyRead(20);
+        QCoreApplication::processEvents();
+        rs3 += p3.takeMessages();
+    }
+    qDebug() << "Result: " << rs3.size() << "messages";
+    Q_ASSERT(rs3.size() == 11 && rs3.at(10) == QString::fromUtf8("<m>caf\xc3\xa9</m>"));
+    qDebug() << "Test 3 passed\n----------\n";
+#endif
+}
+
+void
+SimpleXmlParser::test_parseFile()
+{
+    //mapped 64 bytes at a time: messages across windows, one bigger than a window and an unterminated one
+    QByteArray ts1 = "junk<m><id>1</id></m>\n<m><id>2</id><v>caf\xc3\xa9</v></m>\n<m>" + QByteArray(150, 'x') + "</m>";
+    for (int i = 3; i < 10; i++) {
+        ts1 += "<m><id>" + QByteArray::number(i) + "</id></m>\n";
+    }
+    QByteArray tail = "<m><id>10</i";
+    QTemporaryFile file;
+    file.open();
+    file.write(ts1 + tail);
+    file.close();
+
+    SimpleXmlParser reference;
+    reference.setStartTag("m");
+    reference.addUtf8Data(ts1 + tail);
+    QList<QByteArray> expected = reference.takeMessagesUtf8();
+
+    SimpleXmlParser p1;
+    p1.setStartTag("m");
+    p1.m_mapWindowBytes = 64;
+    bool parsed = p1.parseFile(file.fileName());
+    Q_ASSERT(parsed);
+    QList<QByteArray> rs1 = p1.takeMessagesUtf8();
+    qDebug() << "Result: " << rs1.size() << "messages";
+    Q_ASSERT(expected.size() == 10 && rs1 == expected);
+    Q_ASSERT(p1.getCurrentBufferUtf8() == tail);
+    p1.addUtf8Data("d></m>");
+    QString completed = p1.getNextMessage();
+    Q_ASSERT(completed == "<m><id>10</id></m>");
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //with a message already in progress the file is read into the buffer instead
+    SimpleXmlParser p2;
+    p2.setStartTag("m");
+    p2.addUtf8Data("<m>before ");
+    parsed = p2.parseFile(file.fileName());
+    Q_ASSERT(parsed);
+    QList<QByteArray> rs2 = p2.takeMessagesUtf8();
+    Q_ASSERT(rs2.size() == 10 && rs2.at(0) == "<m>before junk<m><id>1</id></m>" && rs2.at(9) == expected.at(9));
+    parsed = p2.parseFile(file.fileName() + ".missing");
+    Q_ASSERT(!parsed);
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //a message over the maximum buffer size stops the mapping
+    SimpleXmlParser p3;
+    p3.setStartTag("m");
+    p3.setMaxBufferSize(100);
+    p3.m_mapWindowBytes = 64;
+    QList<ParseErrorEnumType> errors;
+    connect(&p3, &SimpleXmlParser::parseErrorFound, [&errors](ParseErrorEnumType e) { errors << e; });
+    parsed = p3.parseFile(file.fileName());
+    Q_ASSERT(!parsed);
+    QStringList rs3 = p3.takeMessages();
+    Q_ASSERT(rs3.size() == 2 && errors.size() == 1 && errors.at(0) == E_MessageTooBig);
+    qDebug() << "Test 3 passed\n----------\n";
+
+    //no window is mapped beyond the limit, even the first one: with 64 bytes windows the second message
+    //(30 bytes with the newline before it) is framed with a 32 bytes limit but not with a 24 bytes one
+    QList<int> framed;
+    for (int limit = 24; limit <= 32; limit += 8) {
+        SimpleXmlParser p4;
+        p4.setStartTag("m");
+        p4.setMaxBufferSize(limit);
+        p4.m_mapWindowBytes = 64;
+        parsed = p4.parseFile(file.fileName());
+        Q_ASSERT(!parsed);
+        framed << p4.takeMessages().size();
+    }
+    qDebug() << "Result: " << framed;
+    Q_ASSERT(framed == (QList<int>() << 1 << 2));
+    qDebug() << "Test 4 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_pipeline()
+{
+    //the workers finish out of order (the even messages take longer), the results come out in order
+    QString ts1;
+    for (int i = 0; i < 300; i++) {
+        ts1 += QString("<m><id>%1</id></m>").arg(i);
+    }
+    SimpleXmlParser p1;
+    p1.setStartTag("m");
+    p1.setExtractionPipeline([](QStringView msg) {
+        int id = SimpleXmlParser::getTagValue(msg.toString(), "id").toInt();
+        if (id % 2 == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return QVariant(id);
+    }, 3);
+    Q_ASSERT(p1.getExtractionThreads() == 3);
+    QList<int> rs1;
+    connect(&p1, &SimpleXmlParser::messageExtracted, [&rs1](QVariant result) { rs1 << result.toInt(); });
+    p1.addData(ts1);    //more messages than the pipeline holds, addData() runs extractions too
+    p1.waitForExtraction();
+    qDebug() << "Result: " << rs1.size() << "results";
+    Q_ASSERT(rs1.size() == 300 && !p1.hasPendingMessages());
+    for (int i = 0; i < rs1.size(); i++) {
+        Q_ASSERT(rs1.at(i) == i);
+    }
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //without waiting the results are emitted from the event loop, UTF-8 messages included
+    rs1.clear();
+    p1.addUtf8Data("<m><id>1</id></m><m><id>2</id></m><m><id>3</id></m>");
+    for (int round = 0; round < 100 && rs1.size() < 3; round++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        QCoreApplication::processEvents();
+    }
+    Q_ASSERT(rs1 == (QList<int>() << 1 << 2 << 3));
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //once removed the messages are queued again
+    p1.setExtractionPipeline(ExtractionFunction());
+    p1.addData("<m><id>4</id></m>");
+    QString unextracted = p1.getNextMessage();
+    Q_ASSERT(p1.getExtractionThreads() == 0 && unextracted == "<m><id>4</id></m>");
+    qDebug() << "Test 3 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_parallelScan()
+{
+    //random messages full of traps for a chunk scanned on its own: tags inside comments, CDATA sections,
+    //processing instructions and attribute values, nesting, empty and unterminated tags
+    static const char *const fragments[] = {
+        "<a>", "</a>", "<a x=\"1\">", "<a/>", "<a y='<a >'>", "<!-- <a> </a> -->", "<![CDATA[ <a></a> ]]>",
+        "<?pi <a>?>", "<b>", "</b>", "<ab>", "</ab>", "text", " < ", "&amp;", "<a\n>", "<a x=\">\"/>", "</a"
+    };
+    const int fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+    const int savedMinChunk = s_parallelMinChunk;
+    unsigned int seed = 76;
+    TagQuery query("a");
+    int checks = 0;
+
+    for (int m = 0; m < 40; m++) {
+        QString msg;
+        for (int i = 0; i < 200; i++) {
+            seed = seed * 1103515245u + 12345u;
+            msg += fragments[(seed >> 16) % fragmentCount];
+        }
+        if (m % 4 == 3)
+            msg += "<a x=\"never closed";
+
+        QList<int> endOffsets;
+        QVector<QStringView> values = getTagsValuesViews(msg, query, &endOffsets);
+        SimpleXmlIndex index;
+        bool wellFormed = index.build(msg);
+
+        for (int minChunk = 1; minChunk <= 64; minChunk *= 4) {
+            s_parallelMinChunk = minChunk;
+            for (int threads = 2; threads <= 16; threads *= 2) {
+                QList<int> endOffsets2;
+                QVector<QStringView> values2 = getTagsValuesViewsParallel(msg, query, threads, &endOffsets2);
+                Q_ASSERT(values2.size() == values.size() && endOffsets2 == endOffsets);
+                for (int i = 0; i < values.size(); i++) {
+                    Q_ASSERT(values2.at(i).data() == values.at(i).data() && values2.at(i).size() == values.at(i).size());
+                }
+
+                SimpleXmlIndex index2;
+                bool wellFormed2 = index2.buildParallel(msg, threads);
+                Q_ASSERT(wellFormed2 == wellFormed);
+                Q_ASSERT(index2.count() == index.count());
+                for (int e = 0; e < index.count(); e++) {
+                    //the records are plain ints
+                    Q_ASSERT(memcmp(&index2.element(e), &index.element(e), sizeof(SimpleXmlIndex::Element)) == 0);
+                }
+                checks++;
+            }
+        }
+    }
+    s_parallelMinChunk = savedMinChunk;
+    qDebug() << "Result: " << checks << "parallel scans identical to the sequential ones";
+    Q_ASSERT(getTagsValuesParallel("<a>1</a><a>2</a>", "a", 4) == (QStringList() << "1" << "2"));
+    qDebug() << "Test 1 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_startTags()
+{
+    //three kinds of messages on the same stream, fed one character at a time
+    QString ts1 = "junk</TrapList><TestPlan version=\"2\" note=\"a > b\"><id>1</id><TrapList>inner</TrapList></TestPlan>"
+                  "<Heartbeat/><TestPlanX>not framed</TestPlanX><TrapList><id>2</id></TrapList><Heartbeat seq=\"3\"/><TestPlan>";
+    SimpleXmlParser p1;
+    p1.setStartTag("TestPlan");
+    p1.addStartTag("TrapList");
+    p1.addStartTag("Heartbeat");
+    p1.addStartTag("TrapList");
+    p1.addTagToFind("id");
+    QStringList ids;
+    int unmatched = 0;
+    connect(&p1, &SimpleXmlParser::foundTag, [&ids](QString, QString value) { ids << value; });
+    connect(&p1, &SimpleXmlParser::parseErrorFound, [&unmatched](ParseErrorEnumType e) { unmatched += e == E_EndTagNotMatched; });
+    for (int i = 0; i < ts1.size(); i++) {
+        p1.addData(ts1.mid(i, 1));
+    }
+
+    QStringList rs1, kinds1;
+    QString kind;
+    while (p1.hasPendingMessages()) {
+        rs1 << p1.getNextMessage(&kind);
+        kinds1 << kind;
+    }
+    qDebug() << "Result: " << kinds1;
+    Q_ASSERT(kinds1 == (QStringList() << "TestPlan" << "Heartbeat" << "TrapList" << "Heartbeat"));
+    Q_ASSERT(rs1.at(0) == "<TestPlan version=\"2\" note=\"a > b\"><id>1</id><TrapList>inner</TrapList></TestPlan>");
+    Q_ASSERT(rs1.at(1) == "<Heartbeat/>" && rs1.at(3) == "<Heartbeat seq=\"3\"/>");
+    Q_ASSERT(rs1.at(2) == "<TrapList><id>2</id></TrapList>");
+    Q_ASSERT(ids == (QStringList() << "1" << "2") && unmatched == 1);
+    Q_ASSERT(p1.getCurrentBuffer() == "<TestPlan>");
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //the same on the UTF-8 path
+    SimpleXmlParser p2;
+    p2.setStartTag("TestPlan");
+    p2.addStartTag("TrapList");
+    p2.addStartTag("Heartbeat");
+    QByteArray ts2 = ts1.toUtf8();
+    for (int i = 0; i < ts2.size(); i += 5) {
+        p2.addUtf8Data(ts2.mid(i, 5));
+    }
+    QStringList kinds2;
+    for (int i = 0; i < rs1.size(); i++) {
+        QByteArray msg = p2.getNextMessageUtf8(&kind);
+        Q_ASSERT(msg == rs1.at(i).toUtf8());
+        kinds2 << kind;
+    }
+    Q_ASSERT(kinds2 == kinds1 && !p2.hasPendingMessages());
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //a malformed start tag of one kind does not hold back the messages of the others
+    QString ts3 = "<TestPlan version=\"2><Heartbeat/><TrapList><id>3</id></TrapList><TestPlan>ok</TestPlan>";
+    SimpleXmlParser p3;
+    p3.setStartTag("TestPlan");
+    p3.addStartTag("TrapList");
+    p3.addStartTag("Heartbeat");
+    SimpleXmlParser p4;
+    p4.setStartTag("TestPlan");
+    p4.addStartTag("TrapList");
+    p4.addStartTag("Heartbeat");
+    QByteArray ts4 = ts3.toUtf8();
+    for (int i = 0; i < ts3.size(); i += 4) {
+        p3.addData(ts3.mid(i, 4));
+        p4.addUtf8Data(ts4.mid(i, 4));
+    }
+    QStringList rs3, kinds3;
+    while (p3.hasPendingMessages()) {
+        rs3 << p3.getNextMessage(&kind);
+        kinds3 << kind;
+    }
+    QStringList rs4 = p4.takeMessages();
+    qDebug() << "Result: " << rs3;
+    Q_ASSERT(kinds3 == (QStringList() << "Heartbeat" << "TrapList" << "TestPlan"));
+    Q_ASSERT(rs3 == (QStringList() << "<Heartbeat/>" << "<TrapList><id>3</id></TrapList>" << "<TestPlan>ok</TestPlan>"));
+    Q_ASSERT(rs4 == rs3);
+    Q_ASSERT(p3.getCurrentBuffer().isEmpty());
+    qDebug() << "Test 3 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_resync()
+{
+    //a message too big for the buffer is dropped while it streams in and the next one is framed as usual
+    QString big = "<m>" + QString(100, 'x') + "<x/></m>junk";
+    QString ts1 = "<m>1</m>" + big + "<m>2</m>";
+    SimpleXmlParser p1;
+    p1.setStartTag("m");
+    p1.setMaxBufferSize(40);
+    p1.setBufferFullPolicy(E_BufferResync);
+    QList<ParseErrorEnumType> errors;
+    connect(&p1, &SimpleXmlParser::parseErrorFound, [&errors](ParseErrorEnumType e) { errors << e; });
+    int maxBuffered = 0;
+    for (int i = 0; i < ts1.size(); i += 7) {
+        p1.addData(ts1.mid(i, 7));
+        maxBuffered = qMax(maxBuffered, p1.getCurrentBuffer().size());
+    }
+    QStringList rs1 = p1.takeMessages();
+    qDebug() << "Result: " << rs1 << p1.getSkippedBytes() << maxBuffered;
+    Q_ASSERT(rs1 == (QStringList() << "<m>1</m>" << "<m>2</m>"));
+    Q_ASSERT(errors == (QList<ParseErrorEnumType>() << E_MessageTooBig));
+    Q_ASSERT(maxBuffered <= 20 && p1.getSkippedBytes() == 2 * big.size());
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //the same with the whole stream in one chunk, on the UTF-8 path
+    SimpleXmlParser p2;
+    p2.setStartTag("m");
+    p2.setMaxBufferSize(40);
+    p2.setBufferFullPolicy(E_BufferResync);
+    p2.addUtf8Data(ts1.toUtf8());
+    QStringList rs2 = p2.takeMessages();
+    Q_ASSERT(rs2 == rs1 && p2.getSkippedBytes() == big.size());
+    //it keeps working, no emptyBuffer() is needed
+    p2.addUtf8Data("<m>3</m>");
+    QString next = p2.getNextMessage();
+    Q_ASSERT(next == "<m>3</m>" && p2.getSkippedBytes() == big.size());
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //in a mapped file a message bigger than both the window and the limit is skipped
+    QTemporaryFile file;
+    bool opened = file.open();
+    Q_ASSERT(opened);
+    file.write(ts1.toUtf8());
+    file.close();
+    SimpleXmlParser p3;
+    p3.setStartTag("m");
+    p3.setMaxBufferSize(32);
+    p3.setBufferFullPolicy(E_BufferResync);
+    p3.m_mapWindowBytes = 16;
+    bool parsed = p3.parseFile(file.fileName());
+    Q_ASSERT(parsed);
+    QStringList rs3 = p3.takeMessages();
+    qDebug() << "Result: " << rs3 << p3.getSkippedBytes();
+    Q_ASSERT(rs3 == rs1 && p3.getSkippedBytes() == big.size());
+    qDebug() << "Test 3 passed\n----------\n";
+
+    //in E_BufferReject mode nothing is counted as skipped: a start tag that never closed is dropped to make room
+    //and a message too big is kept until emptyBuffer()
+    SimpleXmlParser p4;
+    p4.setStartTag("m");
+    p4.setMaxBufferSize(40);
+    QList<ParseErrorEnumType> errors4;
+    connect(&p4, &SimpleXmlParser::parseErrorFound, [&errors4](ParseErrorEnumType e) { errors4 << e; });
+    QString ts4 = "<m a=\"" + QString(100, 'x') + "<m>4</m>" + big;
+    for (int i = 0; i < ts4.size(); i += 7) {
+        p4.addData(ts4.mid(i, 7));
+    }
+    QStringList rs4 = p4.takeMessages();
+    qDebug() << "Result: " << rs4 << p4.getSkippedBytes() << errors4.size();
+    Q_ASSERT(rs4 == (QStringList() << "<m>4</m>") && p4.getCurrentBuffer().startsWith("<m>xxx"));
+    Q_ASSERT(!errors4.isEmpty());
+    for (int i = 0; i < errors4.size(); i++) {
+        Q_ASSERT(errors4.at(i) == E_MessageTooBig);
+    }
+    Q_ASSERT(p4.getSkippedBytes() == 0);
+    p4.emptyBuffer();
+    p4.addData("<m>5</m>");
+    QString last = p4.getNextMessage();
+    Q_ASSERT(last == "<m>5</m>" && p4.getSkippedBytes() == 0);
+    qDebug() << "Test 4 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_spill()
+{
+    //a big message goes to a file while it streams in, the buffer stays small and the small messages are queued
+    QString big = "<dump><id>1</id>";
+    for (int i = 0; i < 200; i++) {
+        big += QString("<row n=\"%1\">caf%2 %3</row>").arg(i).arg(QChar(0xe9)).arg(QString::fromUtf8("\xf0\x9f\x98\x80"));
+    }
+    big += "<id>2</id></dump>";
+    QString ts1 = "junk" + big + "<dump>small</dump>";
+    SimpleXmlParser p1;
+    p1.setStartTag("dump");
+    p1.addTagToFind("id");
+    p1.setSpillThreshold(64);
+    QList<QSharedPointer<QFile> > files;
+    QStringList ids;
+    connect(&p1, &SimpleXmlParser::parsedMessageFile, [&files](QSharedPointer<QFile> file) { files << file; });
+    connect(&p1, &SimpleXmlParser::foundTag, [&ids](QString, QString value) { ids << value; });
+    int maxBuffered = 0;
+    for (int i = 0; i < ts1.size(); i += 9) {
+        p1.addData(ts1.mid(i, 9));
+        maxBuffered = qMax(maxBuffered, p1.getCurrentBuffer().size());
+    }
+    qDebug() << "Result: " << files.size() << maxBuffered << ids;
+    Q_ASSERT(files.size() == 1);
+    QByteArray spilled = files.at(0)->readAll();
+    Q_ASSERT(spilled == big.toUtf8());
+    Q_ASSERT(maxBuffered <= 32 + 9 && ids == (QStringList() << "1" << "2"));
+    QString small = p1.getNextMessage();
+    Q_ASSERT(small == "<dump>small</dump>" && !p1.hasPendingMessages());
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //the same on the UTF-8 path, the file is mapped
+    SimpleXmlParser p2;
+    p2.setStartTag("dump");
+    p2.setSpillThreshold(64);
+    QList<QSharedPointer<QFile> > files2;
+    connect(&p2, &SimpleXmlParser::parsedMessageFile, [&files2](QSharedPointer<QFile> file) { files2 << file; });
+    QByteArray ts2 = ts1.toUtf8();
+    for (int i = 0; i < ts2.size(); i += 7) {
+        p2.addUtf8Data(ts2.mid(i, 7));
+        Q_ASSERT(p2.getCurrentBufferUtf8().size() <= 64 + 7);
+    }
+    Q_ASSERT(files2.size() == 1);
+    uchar *mapped = files2.at(0)->map(0, files2.at(0)->size());
+    Q_ASSERT(mapped && QByteArray(reinterpret_cast<const char *>(mapped), int(files2.at(0)->size())) == big.toUtf8());
+    files2.at(0)->unmap(mapped);
+    small = p2.getNextMessage();
+    Q_ASSERT(small == "<dump>small</dump>");
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //a spill that can not be written drops the message
+    SimpleXmlParser p3;
+    p3.setStartTag("dump");
+    p3.setSpillThreshold(64, "/nonexistent/directory");
+    QList<ParseErrorEnumType> errors;
+    connect(&p3, &SimpleXmlParser::parseErrorFound, [&errors](ParseErrorEnumType e) { errors << e; });
+    for (int i = 0; i < ts1.size(); i += 50) {
+        p3.addData(ts1.mid(i, 50));
+    }
+    Q_ASSERT(errors == (QList<ParseErrorEnumType>() << E_SpillFailed));
+    small = p3.getNextMessage();
+    Q_ASSERT(small == "<dump>small</dump>" && !p3.hasPendingMessages());
+    qDebug() << "Test 3 passed\n----------\n";
+}
+
+void
+SimpleXmlParser::test_typedValues()
+{
+    QString ts1 = "<TestPlan><TPID> 76 </TPID><VlanId>+1</VlanId><Big>9000000000</Big><Neg>-5</Neg><Ratio>2.5e3</Ratio>"
+                  "<Enabled>true</Enabled><Off>0</Off><Bad>7x</Bad><Empty></Empty><Wide>&#49;</Wide>"
+                  "<Test id=\"12\" weight=\"0.25\" active=\"false\" name=\"ping\"><Duration>60</Duration></Test></TestPlan>";
+    ValueError error;
+    int i = getTagValueAs<int>(ts1, "TPID", 0, -1, &error);
+    Q_ASSERT(i == 76 && error == E_ValueOk);
+    Q_ASSERT(getTagValueAs<int>(ts1, TagQuery("VlanId")) == 1);
+    i = getTagValueAs<int>(ts1, "Big", 0, -1, &error);
+    Q_ASSERT(i == -1 && error == E_ValueOutOfRange);
+    qint64 big = getTagValueAs<qint64>(ts1, "Big", 0, -1, &error);
+    Q_ASSERT(big == qint64(9000000000LL) && error == E_ValueOk);
+    Q_ASSERT(getTagValueAs<qint64>(ts1, "Neg") == -5);
+    uint u = getTagValueAs<uint>(ts1, "Neg", 0, 3, &error);
+    Q_ASSERT(u == 3 && error == E_ValueInvalid);
+    Q_ASSERT(getTagValueAs<quint64>(ts1, "Big") == quint64(9000000000ULL));
+    Q_ASSERT(getTagValueAs<double>(ts1, "Ratio") == 2500.0);
+    bool b = getTagValueAs<bool>(ts1, "Off", 0, true, &error);
+    Q_ASSERT(getTagValueAs<bool>(ts1, "Enabled") && !b && error == E_ValueOk);
+    b = getTagValueAs<bool>(ts1, "TPID", 0, true, &error);
+    Q_ASSERT(b && error == E_ValueInvalid);
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //not found, malformed and empty values give the default and say why
+    i = getTagValueAs<int>(ts1, "Missing", 0, 42, &error);
+    Q_ASSERT(i == 42 && error == E_ValueNotFound);
+    i = getTagValueAs<int>(ts1, "Bad", 0, 42, &error);
+    Q_ASSERT(i == 42 && error == E_ValueInvalid);
+    i = getTagValueAs<int>(ts1, "Empty", 0, 42, &error);
+    Q_ASSERT(i == 42 && error == E_ValueInvalid);
+    i = getTagValueAs<int>(ts1, "Wide", 0, 42, &error);
+    Q_ASSERT(i == 42 && error == E_ValueInvalid);      //entities are not decoded
+    i = getTagValueAs<int>(ts1, "TPID", ts1.indexOf("</TPID>"), 42, &error);
+    Q_ASSERT(i == 42 && error == E_ValueNotFound);
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //attributes
+    TagQuery test("Test");
+    i = getTagAttributeAs<int>(ts1, test, "id", 0, 0, &error);
+    Q_ASSERT(i == 12 && error == E_ValueOk);
+    Q_ASSERT(getTagAttributeAs<double>(ts1, "Test", "weight") == 0.25);
+    b = getTagAttributeAs<bool>(ts1, test, "active", 0, true, &error);
+    Q_ASSERT(b == false && error == E_ValueOk);
+    i = getTagAttributeAs<int>(ts1, test, "name", 0, -1, &error);
+    Q_ASSERT(i == -1 && error == E_ValueInvalid);
+    i = getTagAttributeAs<int>(ts1, test, "nope", 0, -1, &error);
+    Q_ASSERT(i == -1 && error == E_ValueNotFound);
+    i = getTagAttributeAs<int>(ts1, "Nope", "id", 0, -1, &error);
+    Q_ASSERT(i == -1 && error == E_ValueNotFound);
+    Q_ASSERT(getTagAttributeView(ts1, test, "name") == QString("ping"));
+    qDebug() << "Test 3 passed\n----------\n";
+
+    //the conversion alone, on any view
+    int n = 0;
+    error = parseValue(QStringView(u"\t-2147483648\n"), n);
+    Q_ASSERT(error == E_ValueOk && n == INT_MIN);
+    error = parseValue(QStringView(u"2147483648"), n);
+    Q_ASSERT(error == E_ValueOutOfRange && n == INT_MIN);
+    error = parseValue(QStringView(u"+-1"), n);
+    ValueError error2 = parseValue(QStringView(u"0x10"), n);
+    Q_ASSERT(error == E_ValueInvalid && error2 == E_ValueInvalid);
+    error = parseValue(QStringView(u"\u0661"), n);
+    Q_ASSERT(error == E_ValueInvalid);      //only ASCII digits
+    qDebug() << "Test 4 passed\n----------\n";
+}
+
+/* the testplan of testplan_76.xml, as test_bind() fills it */
+struct BoundParam
+{
+    QString name;
+    QString value;
+};
+SXML_BINDING(BoundParam,
+             SimpleXmlBind::tag("ParamName", &BoundParam::name),
+             SimpleXmlBind::tag("ParamValue", &BoundParam::value))
+
+struct BoundTestData
+{
+    int testId = 0;
+    int duration = 0;
+    QVector<BoundParam> params;
+};
+SXML_BINDING(BoundTestData,
+             SimpleXmlBind::tag("TestID", &BoundTestData::testId),
+             SimpleXmlBind::tag("Duration", &BoundTestData::duration),
+             SimpleXmlBind::list("Param", &BoundTestData::params))
+
+struct BoundTest
+{
+    int srcAgentId = 0;
+    int dstAgentId = 0;
+    QList<BoundTestData> tests;
+};
+SXML_BINDING(BoundTest,
+             SimpleXmlBind::tag("srcAgentId", &BoundTest::srcAgentId),
+             SimpleXmlBind::tag("dstAgentId", &BoundTest::dstAgentId),
+             SimpleXmlBind::list("TestList", "TestData", &BoundTest::tests))
+
+struct BoundPhase
+{
+    int phid = 0;
+    BoundTest test;
+};
+SXML_BINDING(BoundPhase,
+             SimpleXmlBind::attribute("phid", &BoundPhase::phid),
+             SimpleXmlBind::tag("Test", &BoundPhase::test))
+
+struct BoundPlan
+{
+    qint64 tpid = 0;
+    int vlanId = 0;
+    bool repeat = true;
+    QString owner = "nobody";
+    QVector<BoundPhase> phases;
+};
+SXML_BINDING(BoundPlan,
+             SimpleXmlBind::tag("TPID", &BoundPlan::tpid),
+             SimpleXmlBind::tag("VlanId", &BoundPlan::vlanId),
+             SimpleXmlBind::tag("RepeatMode", &BoundPlan::repeat),
+             SimpleXmlBind::tag("Owner", &BoundPlan::owner),
+             SimpleXmlBind::list("PhaseList", "Phase", &BoundPlan::phases))
+
+void
+SimpleXmlParser::test_bind()
+{
+    QFile file("testplan_76.xml");
+    bool opened = file.open(QIODevice::ReadOnly);
+    Q_ASSERT(opened);
+    QString ts1 = QString::fromUtf8(file.readAll());
+
+    BoundPlan plan;
+    bool filled = SimpleXmlBind::fill(ts1, plan);
+    Q_ASSERT(filled);
+    qDebug() << "Result: " << plan.tpid << plan.vlanId << plan.repeat << plan.owner << plan.phases.size();
+    Q_ASSERT(plan.tpid == 76 && plan.vlanId == 1 && !plan.repeat && plan.owner == "nobody" && plan.phases.size() == 2);
+    for (int i = 0; i < plan.phases.size(); i++) {
+        const BoundTest &test = plan.phases.at(i).test;
+        Q_ASSERT(plan.phases.at(i).phid == i + 1 && test.srcAgentId == (i == 0 ? 1 : 5) && test.dstAgentId == (i == 0 ? 5 : 1));
+        Q_ASSERT(test.tests.size() == 3);
+        for (int t = 0; t < test.tests.size(); t++) {
+            Q_ASSERT(test.tests.at(t).testId == t + 1 && test.tests.at(t).duration == 60);
+            Q_ASSERT(test.tests.at(t).params.size() == 1 && test.tests.at(t).params.at(0).name.isEmpty());
+        }
+    }
+    qDebug() << "Test 1 passed\n----------\n";
+
+    //the same values as the getters give, unknown elements, comments and nested elements with the same name are skipped
+    QString ts2 = "<?xml version=\"1.0\"?><TestData><!-- <TestID>9</TestID> --><Extra><TestID>8</TestID><Extra/></Extra>"
+                  "<TestID> 4 </TestID><Duration>x</Duration><Param><ParamName>a&amp;b</ParamName><ParamValue><![CDATA[1]]></ParamValue></Param>"
+                  "<Param><ParamName>c</ParamName></Param></TestData>";
+    BoundTestData data;
+    data.duration = -1;
+    filled = SimpleXmlBind::fill(ts2, data);
+    Q_ASSERT(filled);
+    Q_ASSERT(data.testId == 4 && data.duration == -1 && data.params.size() == 2);
+    Q_ASSERT(data.params.at(0).name == getDecodedTagValue(ts2, "ParamName") && data.params.at(0).value == "<![CDATA[1]]>");
+    Q_ASSERT(data.params.at(1).name == "c" && data.params.at(1).value.isEmpty());
+    qDebug() << "Test 2 passed\n----------\n";
+
+    //every element with a name, wherever it is, and a truncated message
+    QVector<BoundTestData> all = SimpleXmlBind::fillAll<BoundTestData>(ts1, "TestData");
+    Q_ASSERT(all.size() == 7 && all.at(0).testId == 0 && all.at(6).testId == 3);
+    BoundPlan truncated;
+    filled = SimpleXmlBind::fill(ts1.left(ts1.indexOf("</TestList>")), truncated);
+    Q_ASSERT(!filled && truncated.tpid == 76 && truncated.phases.size() == 1);
+    filled = SimpleXmlBind::fill(QString("no markup"), truncated);
+    Q_ASSERT(!filled);
+    qDebug() << "Test 3 passed\n----------\n";
+}
+
+/************* END OF TEST FNXS ************/
+
+/*!
+  \brief takes the next message
+  \param startTag if not null, it receives the name of the start tag the message was framed with (see addStartTag())
+  */
+QString
+SimpleXmlParser::getNextMessage(QString *startTag)
+{
+    Message m;
+    if (!m_parsedMessages.tryPop(m))
+        return "";
+
+    resumeReadingIfDrained();
+    if (startTag)
+        *startTag = startTagName(m.startTag);
+    return m.toString();
+}
+
+
+
+/*!
+  \brief takes the next message encoded in UTF-8, no conversion is done for the messages fed with addUtf8Data()
+  \return an empty array if there are no messages
+  */
+QByteArray
+SimpleXmlParser::getNextMessageUtf8(QString *startTag)
+{
+    Message m;
+    if (!m_parsedMessages.tryPop(m))
+        return QByteArray();
+
+    resumeReadingIfDrained();
+    if (startTag)
+        *startTag = startTagName(m.startTag);
+    return m.toUtf8();
+}
+
+
+
+/*!
+  \brief takes up to \a maxCount messages (all of them if negative) in one call, oldest first
+  */
+QStringList
+SimpleXmlParser::takeMessages(int maxCount)
+{
+    QStringList messages;
+    Message m;
+    while ((maxCount < 0 || messages.size() < maxCount) && m_parsedMessages.tryPop(m)) {
+        messages << m.toString();
+    }
+    resumeReadingIfDrained();
+    return messages;
+}
+
+
+
+QList<QByteArray>
+SimpleXmlParser::takeMessagesUtf8(int maxCount)
+{
+    QList<QByteArray> messages;
+    Message m;
+    while ((maxCount < 0 || messages.size() < maxCount) && m_parsedMessages.tryPop(m)) {
+        messages << m.toUtf8();
+    }
+    resumeReadingIfDrained();
+    return messages;
+}
+
+/*!
+  \brief sets when parsedMessages() is emitted in E_DispatchBatch mode
+  By default (\a msecs 0) every addData() call emits the messages it completed in one signal, otherwise the messages
+  are collected for \a msecs starting from the first one. If \a maxMessages is greater than 0 a batch is emitted as
+  soon as it reaches that many messages, even in the middle of an addData() call.
+  \note the time window needs an event loop running in the thread of the parser
+  */
+void
+SimpleXmlParser::setBatchWindow(int msecs, int maxMessages)
+{
+    m_batchWindowMsecs = qMax(msecs, 0);
+    m_batchMaxMessages = qMax(maxMessages, 0);
+}
+
+
+
+/*!
+  \brief emits parsedMessages() right away with the messages collected so far in E_DispatchBatch mode, if any
+  The messages fed with addUtf8Data() are emitted with parsedMessagesUtf8() instead.
+  */
+void
+SimpleXmlParser::flushBatch()
+{
+    if (m_batchTimer)
+        m_batchTimer->stop();
+    if (m_batch.isEmpty() && m_batchUtf8.isEmpty())
+        return;
+
+    QStringList batch;
+    batch.swap(m_batch);
+    QList<QByteArray> batchUtf8;
+    batchUtf8.swap(m_batchUtf8);
+    if (!batch.isEmpty())
+        emit parsedMessages(batch);
+    if (!batchUtf8.isEmpty())
+        emit parsedMessagesUtf8(batchUtf8);
+}
+
+
+
+/*!
+  \brief puts \a msg in the queue of the parsed messages applying the policy set for a full queue
+  \note with E_QueueBlock the messages must be taken by another thread or addData() never returns
+  \return false if the message was rejected
+  */
+bool
+SimpleXmlParser::enqueueMessage(const Message &msg)
+{
+    Message m(msg);
+    while (!m_parsedMessages.tryPush(m)) {
+        switch (m_queueFullPolicy) {
+            case E_QueueReject:
+                return false;
+            case E_QueueDropOldest: {
+                //a consumer may have made room meanwhile, report only a message actually dropped
+                Message dropped;
+                if (m_parsedMessages.tryPop(dropped))
+                    emit parseErrorFound(E_QueueFull);
+                break;
+            }
+            case E_QueueBlock:
+                QThread::yieldCurrentThread();
+                break;
+        }
+    }
+    return true;
+}
+
+
+
+/*!
+  \brief queues and/or emits \a msg according to the notification mode
+  The messages fed with addUtf8Data() are dispatched with the Utf8 signals so they are never converted here.
+  */
+void
+SimpleXmlParser::dispatchMessage(const Message &msg)
+{
+    if (m_pipeline) {
+        Message m(msg);
+        while (!m_pipeline->trySubmit(m)) {
+            //the pipeline holds all the results it can: lend the workers a hand, then emit what is ready
+            if (!m_pipeline->help())
+                std::this_thread::yield();
+            deliverExtracted();
+        }
+        return;
+    }
+
+    if (m_notifyMode == E_DispatchBatch) {
+        if (msg.isUtf8)
+            m_batchUtf8 << msg.utf8;
+        else
+            m_batch << msg.text;
+        if (m_batchMaxMessages > 0 && m_batch.size() + m_batchUtf8.size() >= m_batchMaxMessages)
+            flushBatch();
+        return;
+    }
+
+    if (m_notifyMode == E_DispatchMessageAndDelete) {
+        emitParsedMessage(msg);
+        return;
+    }
+
+    //a message the queue rejected cannot be fetched, so it is not notified (but still dispatched)
+    bool queued = enqueueMessage(msg);
+    if (!queued)
+        emit parseErrorFound(E_QueueFull);
+
+    switch(m_notifyMode) {
+        case E_NotifyOnly:
+            if (queued)
+                emit messageCompleted();
+            break;
+        case E_DispatchMessage:
+            emitParsedMessage(msg);
+            break;
+        case E_NotifyAndDispatch:
+            if (queued)
+                emit messageCompleted();
+            emitParsedMessage(msg);
+            break;
+        case E_DispatchMessageAndDelete:
+        case E_DispatchBatch:
+            //We cannot be here, added just to avoid compilation warning
+            break;
+    }
+}
+
+
+
+void
+SimpleXmlParser::deliverExtracted()
+{
+    if (m_pipeline)
+        m_pipeline->deliver([this](const QVariant &result) { emit messageExtracted(result); });
+}
+
+
+
+void
+SimpleXmlParser::emitParsedMessage(const Message &msg)
+{
+    if (msg.isUtf8)
+        emit parsedMessageUtf8(msg.utf8);
+    else
+        emit parsedMessage(msg.text);
+}
+
+
+
+/*!
+  \brief appends a chunk of data to the buffer and extracts every message it completes
+  The framing is done by SimpleXmlCore: the scan restarts from the position where the previous call stopped,
+  so every character is looked at once no matter how the stream is chunked, and the consumed part of the
+  buffer is dropped at most once per call.
+  Inside a message the tags registered with addTagToFind() are recognized by the same scan and foundTag()
+  is emitted with the raw value as soon as each of them closes, even if the message is not complete yet.
+  */
+void
+SimpleXmlParser::addData(const QString &aMsgpart) {
+    feedCore(m_core, utf16(aMsgpart.constData()), aMsgpart.size());
+}
+
+
+
+/*!
+  \brief appends a chunk of UTF-8 data, the same as addData() but the messages are framed on the bytes
+  The buffer takes half the memory and no message is converted to UTF-16 unless it is taken as a QString
+  (see getNextMessageUtf8(), takeMessagesUtf8() and the Utf8 signals). A multibyte character split across
+  chunks is fine. Do not mix it with addData() on the same stream.
+  */
+void
+SimpleXmlParser::addUtf8Data(const QByteArray &aMsgpart)
+{
+    addUtf8Data(aMsgpart.constData(), aMsgpart.size());
+}
+
+
+
+void
+SimpleXmlParser::addUtf8Data(const char *data, int size)
+{
+    feedCore(m_utf8Core, data, size);
+}
+
+
+
+/*!
+  \brief frames the UTF-8 file at \a path without loading it, as if it all was given to addUtf8Data()
+  The file is memory mapped a window (64 MB) at a time and the messages are cut straight out of the
+  mapping, so the memory needed is bounded by the window or by the largest message and not by the file
+  size. The messages are kept in UTF-8 and converted only if taken as QString; to keep the memory low
+  take them as they come or use E_DispatchMessageAndDelete. With \a sequentialHint the kernel is told
+  that the file is read once, in order (madvise() where available).
+  An unterminated message at the end of the file is left in the buffer as addUtf8Data() would leave it.
+  If the file can not be mapped it is read in chunks instead.
+  \return false if the file can not be opened or a message is bigger than the maximum buffer size
+  */
+bool
+SimpleXmlParser::parseFile(const QString &path, bool sequentialHint)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    //the mapping can not continue a stream whose beginning is already in the buffer (or in the spill file)
+    qint64 offset = 0;
+    if (m_utf8Core.bufferSize() == 0 && !m_spillFile) {
+        offset = frameMappedFile(file, sequentialHint);
+        if (offset < 0)
+            return false;
+    }
+
+    //the rest is read, the framing state refers to the data starting at offset
+    if (offset < file.size() && file.seek(offset)) {
+        while (true) {
+            int room = bufferRoom(m_utf8Core);
+            if (room == 0)
+                return false;
+            int chunkSize = room < 0 ? m_readChunkSize : qMin(room, m_readChunkSize);
+            char *chunk = m_utf8Core.reserve(chunkSize);
+            qint64 n = file.read(chunk, chunkSize);
+            m_utf8Core.commit(n < 0 ? 0 : int(n));
+            if (n <= 0)
+                break;
+            frameCore(m_utf8Core);
+        }
+    }
+    return true;
+}
+
+
+
+/*!
+  \brief frames \a file from one mapped window after the other, the next window starts at the unfinished message
+  A message bigger than both the window and the maximum buffer size is skipped in E_BufferResync mode.
+  \return how far the file was framed (to its size unless a mapping failed), -1 if a message is too big
+  */
+qint64
+SimpleXmlParser::frameMappedFile(QFile &file, bool sequentialHint)
+{
+    const qint64 fileSize = file.size();
+    //no window is mapped beyond the maximum buffer size
+    const qint64 maxWindow = m_maxBufferSizeInBytes > 0 ? m_maxBufferSizeInBytes : INT_MAX;
+    const qint64 firstWindow = qMin(qint64(m_mapWindowBytes), maxWindow);
+    qint64 offset = 0;
+    qint64 window = firstWindow;
+    while (offset < fileSize) {
+        const qint64 length = qMin(window, fileSize - offset);
+        uchar *data = file.map(offset, length);
+        if (!data)
+            return offset;
+        if (sequentialHint)
+            adviseSequential(data, length);
+
+        const char *text = reinterpret_cast<const char *>(data);
+        int consumed = frameCore(m_utf8Core, text, int(length));
+        if (offset + length == fileSize) {
+            //what is left has no end, keep it where addUtf8Data() can complete it
+            m_utf8Core.append(text + consumed, int(length) - consumed);
+            file.unmap(data);
+            return fileSize;
+        }
+        file.unmap(data);
+
+        if (consumed > 0) {
+            offset += consumed;
+            window = firstWindow;
+        }
+        else {
+            //the window holds only a part of a message, map it again twice as big up to the limit
+            if (window < maxWindow) {
+                window = qMin(window * 2, maxWindow);
+                continue;
+            }
+            emit parseErrorFound(E_MessageTooBig);
+            if (m_bufferFullPolicy != E_BufferResync)
+                return -1;
+            m_utf8Core.skipMessage(int(length));
+            offset += length;
+            window = firstWindow;
+        }
+    }
+    return offset;
+}
+
+
 
-    rs = SimpleXmlParser::getTagValue(ts4, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="ciao");
-    qDebug() << "Test 4 passed\n----------\n";
+/*!
+  \brief reads \a device as a UTF-8 stream whenever it has data, replacing the device attached before
+  The data is read in chunks straight into the buffer of the parser and framed there, no QByteArray or
+  QString is created per read. The first read is queued, so the signals can be connected after attaching.
+  \note the parser does not take the ownership of \a device, which is detached if destroyed
+  \sa setQueueHighWaterMark()
+  */
+void
+SimpleXmlParser::attach(QIODevice *device)
+{
+    detach();
+    m_device = device;
+    if (!device)
+        return;
 
-    rs = SimpleXmlParser::getTagValue(ts5, "pippo");
-    qDebug() << "Result: " << rs;
-    Q_ASSERT(rs=="ciao");
-    qDebug() << "Test 5 passed\n----------\n";
+    connect(device, &QIODevice::readyRead, this, &SimpleXmlParser::readDevice);
+    QMetaObject::invokeMethod(this, [this]() { readDevice(); }, Qt::QueuedConnection);
+}
 
-    rsl = SimpleXmlParser::getTagsValues(ts6, "pippo");
-    qDebug() << "Result: " << rsl;
-    Q_ASSERT(rsl.size()==2);
-    Q_ASSERT(rsl.at(0)=="ciao");
-    Q_ASSERT(rsl.at(1)=="ciao2");
-    qDebug() << "Test 6 passed\n----------\n";
 
-    rsl = SimpleXmlParser::getTagsValues(ts6, "<pippo>");
-    qDebug() << "Result: " << rsl;
-    Q_ASSERT(rsl.size()==2);
-    Q_ASSERT(rsl.at(0)=="ciao");
-    Q_ASSERT(rsl.at(1)=="ciao2");
-    qDebug() << "Test 6b passed\n----------\n";
 
-    rs = SimpleXmlParser::getTagValue(ts7, "pippo");
-    qDebug() << "Result: " << decodeEntities(rs);
-    Q_ASSERT(decodeEntities(rs)=="alice < bob’s mom & '3 > 1' éà€");
-    qDebug() << "Test 7 passed\n----------\n";
+void
+SimpleXmlParser::detach()
+{
+    if (m_device)
+        disconnect(m_device.data(), &QIODevice::readyRead, this, &SimpleXmlParser::readDevice);
+    m_device = 0;
+    m_readPaused = false;
 }
 
+
+
+/*!
+  \brief sets how many bytes are read from the attached device at a time (16384 by default)
+  */
 void
-SimpleXmlParser::test_getProperty()
+SimpleXmlParser::setReadChunkSize(int bytes)
 {
-    QString ts1 = "<pippo p1='bello' >ciao</pippo>";
-    QString ts2 = "<pippo p1  =  'bello  sguardo' >ciao</pippo>";
-    QString ts3 = "<pippo p1=\"bello 'sguardo' \" p2='ciccio'>ciao</pippo>";
-    QString ts4 = "<pippolist> <pippo p1=\"bello 'sguardo' \" p2='ciccio'>ciao</pippo><pippo p1=\"bello 'sguardo' \" p3='ciccio2'>ciao</pippo></pippolist>";
+    if (bytes > 0) {
+        m_readChunkSize = bytes;
+    }
+}
 
-    QString ts5 = "<TrapList>\
-            <trap\
-            eventType='userInput'\
-            networkType='eth'\
-            isAlice='true'\
-            userName='mario.rossi@gmail.com'\
-            fwVersion='13.16.00'\
-            raVersion='01.11.00'\
-            loVersion='027.072.000'\
-            timestamp='2013/06/07_14:45:13'>\
-            <body\
-            eventName='PLAY'\
-            videoUrl='http%3A%2F%2Fctv.alice.cdn.interbusiness.it%2FDAM%2FV1%2FFilm%2F2012%2F05%2FRA3_50266398.wmv%7CCOMPONENT%3DWMDRM'\
-            videoTitle='Il Gladiatore'\
-            />\
-            </trap>\
-            </TrapList>";
 
-    QString ts6 = "<pippo p1=\"alice &lt; bob&#x2019;s mom &amp; '3 &gt; 1'\" p2='&#233;&#224;&#8364;'>ciao</pippo>";
 
-    QMultiMap<QString, QString>* rm;
-    QMultiMap<QString, QString>* rm2;
-    QList<QMap<QString, QString> >rmlist;
+/*!
+  \brief stops reading the attached device while \a messages or more wait in the queue, 0 (the default) never stops
+  The data is left in the device (for a socket the peer is eventually slowed down by the transport) and
+  reading resumes once the consumers have taken the queue down to half the mark.
+  */
+void
+SimpleXmlParser::setQueueHighWaterMark(int messages)
+{
+    m_queueHighWaterMark = qMax(messages, 0);
+    resumeReadingIfDrained();
+}
 
-    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts1, "pippo"));
-    qDebug() << "Result: " << *rm;
-    Q_ASSERT(rm->contains("p1"));
-    Q_ASSERT(rm->value("p1")=="bello");
-    qDebug() << "Test 1 passed\n----------\n";
-    delete rm;
 
-    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts2, "pippo"));
-    qDebug() << "Result: " << *rm;
-    Q_ASSERT(rm->contains("p1"));
-    Q_ASSERT(rm->value("p1")=="bello  sguardo");
-    qDebug() << "Test 2 passed\n----------\n";
-    delete rm;
 
-    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts3, "pippo"));
-    qDebug() << "Result: " << *rm;
-    Q_ASSERT(rm->contains("p1"));
-    Q_ASSERT(rm->value("p1")=="bello 'sguardo' ");
-    Q_ASSERT(rm->contains("p2"));
-    Q_ASSERT(rm->value("p2")=="ciccio");
-    qDebug() << "Test 3 passed\n----------\n";
-    delete rm;
+/*!
+  \brief runs \a extract on every completed message with \a threads worker threads (0 for one per core)
+  The messages are then neither queued nor dispatched as set with setNotificationMode(), they go to the
+  workers and messageExtracted() is emitted with what \a extract returns, from the thread of the parser and
+  in the order the messages were completed. \a extract runs on several threads at once, the static functions
+  of this class (getTagsValues(), getTagsProperties(), decodeEntities()...) are safe to call from there.
+  An empty \a extract removes the pipeline, the results not emitted yet are lost (see waitForExtraction()).
+  \note it must not be called from a slot connected to messageExtracted()
+  */
+void
+SimpleXmlParser::setExtractionPipeline(const ExtractionFunction &extract, int threads)
+{
+    m_pipeline.reset();
+    if (!extract)
+        return;
 
-    rmlist = SimpleXmlParser::getTagsProperties(ts4, "pippo");
-    qDebug() << "Result0: " << rmlist.at(0);
-    Q_ASSERT(rmlist.at(0).contains("p1"));
-    Q_ASSERT(rmlist.at(0)["p1"]=="bello 'sguardo' ");
-    Q_ASSERT(rmlist.at(0).contains("p2"));
-    Q_ASSERT(rmlist.at(0)["p2"]=="ciccio");
-    qDebug() << "Result1: " << rmlist.at(1);
-    Q_ASSERT(rmlist.at(1).contains("p1"));
-    Q_ASSERT(rmlist.at(1)["p1"]=="bello 'sguardo' ");
-    Q_ASSERT(rmlist.at(1).contains("p3"));
-    Q_ASSERT(rmlist.at(1)["p3"]=="ciccio2");
-    qDebug() << "Test 4 passed\n----------\n";
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    //the messages fed with addUtf8Data() are converted on the workers too
+    ExtractionPipeline::Function function = [extract](const Message &msg) {
+        QString text = msg.toString();
+        return extract(QStringView(text));
+    };
+    m_pipeline.reset(new ExtractionPipeline(function, threads, 64 * threads, [this]() {
+        QMetaObject::invokeMethod(this, [this]() { deliverExtracted(); }, Qt::QueuedConnection);
+    }));
+}
 
-    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts5, "trap"));
-    rm2 = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts5, "body"));
-    rm->unite(*rm2);
-    qDebug() << "Result: " << *rm;
-    Q_ASSERT(rm->contains("eventType"));
-    Q_ASSERT(rm->value("eventType")=="userInput");
-    Q_ASSERT(rm->contains("networkType"));
-    Q_ASSERT(rm->value("networkType")=="eth");
-    Q_ASSERT(rm->contains("eventName"));
-    Q_ASSERT(rm->value("eventName")=="PLAY");
-    qDebug() << "Test 5 passed\n----------\n";
-    delete rm2;
-    delete rm;
 
-    rm = new QMultiMap<QString, QString>(SimpleXmlParser::getTagProperties(ts6, "pippo"));
-    qDebug() << "Result: " << *rm;
-    Q_ASSERT(rm->contains("p1"));
-    Q_ASSERT(decodeEntities(rm->value("p1"))=="alice < bob’s mom & '3 > 1'");
-    Q_ASSERT(rm->contains("p2"));
-    Q_ASSERT(decodeEntities(rm->value("p2"))=="éà€");
-    qDebug() << "Test 6 passed\n----------\n";
-    delete rm;
-}
 
+/*!
+  \brief blocks until the result of every message completed so far has been emitted with messageExtracted()
+  Meanwhile the calling thread, which must be the one of the parser, runs extractions too.
+  */
 void
-SimpleXmlParser::test_addData()
+SimpleXmlParser::waitForExtraction()
 {
-    /* Note: I'm using decodeEntities() to add unicode text to QString
-     * irrespective of IDE/System encoding (GS)
-     */
-    QString tsPart1 = SimpleXmlParser::decodeEntities("<pippo>alice &lt; bob&#x2019;s mom &amp; '3 ");
-    QString tsPart2 = SimpleXmlParser::decodeEntities("&gt; 1' &#233;&#224;&#8364;&#xc29f;</pippo>");
+    while (m_pipeline && !m_pipeline->isDone()) {
+        if (!m_pipeline->help())
+            std::this_thread::yield();
+        deliverExtracted();
+    }
+}
 
-    SimpleXmlParser xmlParser;
-    xmlParser.setStartTag("pippo");
-    xmlParser.addData(tsPart1);
-    xmlParser.addData(tsPart2);
 
-    QString rs;
-    if (xmlParser.hasPendingMessages())
-    {
-        rs = xmlParser.getNextMessage();
+
+void
+SimpleXmlParser::readDevice()
+{
+    while (m_device && !m_readPaused) {
+        if (m_queueHighWaterMark > 0 && m_parsedMessages.sizeHint() >= m_queueHighWaterMark) {
+            m_readPaused = true;
+            //a consumer may have drained the queue before the flag was set, then nobody would resume
+            if (m_parsedMessages.sizeHint() > m_queueHighWaterMark / 2 || !m_readPaused.exchange(false))
+                break;
+        }
+
+        //beyond the maximum size the data is read and dropped, as addData() does
+        int room = bufferRoom(m_utf8Core);
+        bool tooBig = room == 0;
+        int chunkSize = room <= 0 ? m_readChunkSize : qMin(room, m_readChunkSize);
+        char *chunk = m_utf8Core.reserve(chunkSize);
+        qint64 n = m_device->read(chunk, chunkSize);
+        m_utf8Core.commit(tooBig || n < 0 ? 0 : int(n));
+        if (n <= 0)
+            break;
+        if (!tooBig)
+            frameCore(m_utf8Core);
     }
-    qDebug() << "Result: " << decodeEntities(rs);
-    Q_ASSERT(rs == (tsPart1 + tsPart2));
-    qDebug() << "Test 1 passed\n----------\n";
 }
 
-/************* END OF TEST FNXS ************/
 
-/*!
 
+/*!
+  \brief resumes reading the attached device if it was paused and the queue went down to half the high-water mark
+  \note it is called by the consumers, possibly from other threads, so the read is always queued
   */
-QString
-SimpleXmlParser::getNextMessage()
+void
+SimpleXmlParser::resumeReadingIfDrained()
 {
-    QString s;
+    if (m_readPaused.load() && m_parsedMessages.sizeHint() <= m_queueHighWaterMark / 2 && m_readPaused.exchange(false))
+        QMetaObject::invokeMethod(this, [this]() { readDevice(); }, Qt::QueuedConnection);
+}
 
-    muxMsgList.lock();
-        s = m_parsedMessages.isEmpty() ? "" : m_parsedMessages.takeFirst();
-    muxMsgList.unlock();
 
-    return s;
+
+/*!
+  \brief emits E_MessageTooBig if the buffer already holds more than the maximum size set
+  */
+bool
+SimpleXmlParser::bufferLimitReached(int bufferedBytes)
+{
+    if (m_maxBufferSizeInBytes > 0 && bufferedBytes > m_maxBufferSizeInBytes) {
+        emit parseErrorFound(E_MessageTooBig);
+#ifdef SXML_DBG
+        qWarning() << "Buffer size is: "<< bufferedBytes << " we passed the limit, appending not done!";
+#endif
+        return true;
+    }
+    return false;
 }
 
+
+
+/*!
+  \brief appends \a data to \a core (m_core or m_utf8Core) and frames it, in pieces if it does not fit the buffer limit
+  */
+template <typename Core>
 void
-SimpleXmlParser::addData(const QString &aMsgpart) {
-    QString msg;
+SimpleXmlParser::feedCore(Core &core, const typename Core::View::value_type *data, int size)
+{
+    do {
+        int room = bufferRoom(core);
+        if (room == 0)
+            return;
+        int n = room < 0 ? size : qMin(room, size);
+        core.append(data, n);
+        frameCore(core);
+        data += n;
+        size -= n;
+    } while (size > 0);
+}
+
+
+
+/*!
+  \brief how many characters can be appended to \a core within the maximum buffer size, -1 if there is no limit
+  When the buffer is full E_MessageTooBig is emitted and 0 is returned, unless in E_BufferResync mode
+  where the message in progress is dropped to make room. Outside a message the buffer only holds a start tag
+  that never closed, it is dropped in both modes but counted as skipped only in E_BufferResync mode.
+  */
+template <typename Core>
+int
+SimpleXmlParser::bufferRoom(Core &core)
+{
+    typedef typename Core::View::value_type Char;
+    if (m_bufferFullPolicy != E_BufferResync || m_maxBufferSizeInBytes <= 0) {
+        if (!bufferLimitReached(core.bufferSize() * int(sizeof(Char))))
+            return -1;
+        if (core.isInMessage())
+            return 0;
+        core.clear();
+        return -1;
+    }
 
-    if (m_maxBufferSizeInBytes > 0 && m_buffer.size() > m_maxBufferSizeInBytes) {
+    const int limit = qMax(m_maxBufferSizeInBytes / int(sizeof(Char)), 1);
+    if (core.bufferSize() >= limit) {
         emit parseErrorFound(E_MessageTooBig);
 #ifdef SXML_DBG
-        qWarning() << "Buffer size is: "<< m_buffer.size() << " we passed the limit, appending not done!";
+        qWarning() << "SXML - The message in the buffer is too big, skipping to the next start tag";
 #endif
-        return;
+        core.skipMessage();
+        m_spillFile.clear();
     }
+    return limit - core.bufferSize();
+}
+
 
-    m_buffer.append(aMsgpart);
 
-    int idx = m_buffer.indexOf("<" + m_StartTag + ">");
-    int idx2 = m_buffer.indexOf("</" + m_StartTag + ">");
+/*!
+  \brief moves the scanned part of the message in progress from the buffer of \a core to the spill file
+  Nothing is moved until the buffer grows beyond the spill threshold, from then on it is done after every scan.
+  */
+template <typename Core>
+void
+SimpleXmlParser::spillMessageHead(Core &core)
+{
+    typedef typename Core::View::value_type Char;
+    if (!m_spillFile && core.bufferSize() * int(sizeof(Char)) <= m_spillThreshold)
+        return;
+
+    typename Core::View head = core.messageHead();
+    int size = int(head.size());
+    //the file is in UTF-8, a surrogate pair must not be split
+    if (sizeof(Char) == sizeof(QChar) && size > 0 && QChar::isHighSurrogate(uint(head[size - 1])))
+        size--;
+    if (size <= 0)
+        return;
 
-    if (idx2 < 0) { //entire message data did not fit in the read chunk!
+    if (!m_spillFile) {
+        QString dir = m_spillDirectory.isEmpty() ? QDir::tempPath() : m_spillDirectory;
+        QTemporaryFile *file = new QTemporaryFile(dir + "/sxml_spill_XXXXXX");
+        m_spillFile.reset(file);
+        if (!file->open())
+            m_spillFile.clear();
+    }
+    if (!m_spillFile || m_spillFile->write(Message(head.substr(0, size_t(size))).toUtf8()) < 0) {
+        m_spillFile.clear();
+        core.skipMessage();
+        emit parseErrorFound(E_SpillFailed);
+        return;
+    }
+    core.dropMessageHead(size);
 #ifdef SXML_DBG
-        qDebug() << "############ SXML - Storing arrived data for next Chunk #############";
-        qDebug() << "SXML - Current buffer is:\n" << m_buffer;
+    qDebug() << "SXML - Spilled" << size << "characters of the message in progress";
 #endif
+}
+
+
+
+/*!
+  \brief appends \a tail, the end of the message being spilled, to the spill file and emits the file
+  */
+void
+SimpleXmlParser::finishSpill(const Message &tail)
+{
+    QSharedPointer<QFile> file = m_spillFile;
+    m_spillFile.clear();
+    if (file->write(tail.toUtf8()) < 0 || !file->flush() || !file->seek(0)) {
+        emit parseErrorFound(E_SpillFailed);
         return;
     }
-    else {
-        if (idx >= 0 && idx < idx2) {//normal message
-            msg = m_buffer.mid(idx, idx2 - idx + 3 + m_StartTag.length()); //the three bytes are "</>" that sourrounds the star tag
-            m_buffer = m_buffer.mid(idx2 + 3 + m_StartTag.length());
+    emit parsedMessageFile(file);
+}
+
+
+
+/*!
+  \brief frames the data just appended to \a core (m_core or m_utf8Core) and emits what it completed
+  If \a external is given it is framed in place of the buffer, see SimpleXmlCore::frameExternal().
+  \return how much of \a external was consumed
+  */
+template <typename Core>
+int
+SimpleXmlParser::frameCore(Core &core, const typename Core::View::value_type *external, int externalSize)
+{
+    typedef typename Core::View View;
+
+    //the core reports while it scans, the signals are emitted only once its state is consistent
+    struct Collector
+    {
+        struct FoundTag
+        {
+            int tag;
+            QString value;
+            int message;    //the index in messages of the message the tag belongs to
+        };
+
+        QList<Message> messages;
+        QList<FoundTag> foundTags;
+        int unmatchedEndTags;
+
+        void message(int startTag, View msg)
+        {
+            messages << Message(msg);
+            messages.last().startTag = startTag;
 #ifdef SXML_DBG
-            qDebug() << "SXML - We got a message: " << msg;
-            qDebug() << "SXML - Whats left in the buffer:\n" << m_buffer;
+            qDebug() << "SXML - We got a message: " << messages.last().toString();
 #endif
+        }
 
-            //here we have a completed message;
-            if (m_notifyMode == E_DispatchMessageAndDelete) {
-                emit parsedMessage(msg);
-            }
-            else {
-                muxMsgList.lock();
-                    m_parsedMessages.append(msg);
-                muxMsgList.unlock();
-
-                switch(m_notifyMode) {
-                    case E_NotifyOnly:
-                        emit messageCompleted();
-                        break;
-                    case E_DispatchMessage:
-                        emit parsedMessage(msg);
-                        break;
-                    case E_NotifyAndDispatch:
-                        emit messageCompleted();
-                        emit parsedMessage(msg);
-                        break;
-                    case E_DispatchMessageAndDelete:
-                        //We cannot be here, added just to avoid compilation warning
-                        break;
-                }
-            }
+        void tag(int tag, View value)
+        {
+            FoundTag found = { tag, Message(value).toString(), messages.size() };
+            foundTags << found;
+        }
 
-            //now if we still have something in the buffer we go for another check
-            if (!m_buffer.isEmpty()) {
+        void unmatchedEndTag()
+        {
+            unmatchedEndTags++;
 #ifdef SXML_DBG
-                qDebug() << "Buffer size is: "<< m_buffer.size() << " rechecking buffer!";
+            qCritical() << "SXML - END tag is *before* START tag... we probably lost a chunk, dropping it!";
 #endif
-                addData("");
-            }
         }
-        else {
-            if (idx2 < idx) {
-                m_buffer = m_buffer.mid(idx);
+    };
+
+    Collector collected;
+    collected.unmatchedEndTags = 0;
+    int consumed = 0;
+    if (external)
+        consumed = core.frameExternal(external, externalSize, collected);
+    else
+        core.frame(collected);
+
 #ifdef SXML_DBG
-                qCritical() << "SXML - END tag is *before* START tag... we probably lost a chunk, dropping remainder!";
-                qDebug() << "SXML - New buffer contents:\n" << m_buffer;
+    qDebug() << "SXML - Whats left in the buffer:\n" << getCurrentBuffer();
 #endif
-                emit parseErrorFound(E_EndTagNotMatched);
-                addData("");
+
+    //slots may safely call back into us from here
+    for (int i = 0; i < collected.unmatchedEndTags; i++) {
+        emit parseErrorFound(E_EndTagNotMatched);
+    }
+    //the tags of a message come before the message itself, the ones of a message still in progress last
+    int tagIdx = 0;
+    for (int i = 0; i <= collected.messages.size(); i++) {
+        for (; tagIdx < collected.foundTags.size() && collected.foundTags.at(tagIdx).message == i; tagIdx++) {
+            emit foundTag(m_TagsToSignal.at(collected.foundTags.at(tagIdx).tag), collected.foundTags.at(tagIdx).value);
+        }
+        if (i < collected.messages.size()) {
+            //the message being spilled is in progress since before this scan, so it is the first one completed
+            if (i == 0 && m_spillFile)
+                finishSpill(collected.messages.at(i));
+            else
+                dispatchMessage(collected.messages.at(i));
+        }
+    }
+    if (!external && m_spillThreshold > 0)
+        spillMessageHead(core);
+
+    if (m_notifyMode == E_DispatchBatch && (!m_batch.isEmpty() || !m_batchUtf8.isEmpty())) {
+        if (m_batchWindowMsecs <= 0) {
+            flushBatch();
+        }
+        else if (!m_batchTimer || !m_batchTimer->isActive()) {
+            if (!m_batchTimer) {
+                m_batchTimer = new QTimer(this);
+                m_batchTimer->setSingleShot(true);
+                connect(m_batchTimer, &QTimer::timeout, this, &SimpleXmlParser::flushBatch);
             }
+            m_batchTimer->start(m_batchWindowMsecs);
         }
     }
+    return consumed;
+}
+
+/*!
+  \brief takes the next message and indexes it, see SimpleXmlIndex
+  */
+SimpleXmlIndex
+SimpleXmlParser::getNextIndexedMessage()
+{
+    return SimpleXmlIndex(getNextMessage());
 }
 
 bool
 SimpleXmlParser::hasPendingMessages()
 {
-    bool retval = false;
-    muxMsgList.lock();
-        if (m_parsedMessages.count() > 0)
-            retval = true;
-    muxMsgList.unlock();
-    return retval;
+    return !m_parsedMessages.isEmpty();
 }
@@ -7,9 +7,29 @@
 #ifndef SIMPLEXMLPARSER_H
 #define SIMPLEXMLPARSER_H
 
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
 #include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
 #include <QStringList>
-#include <QMutex>
+#include <QStringView>
+#include <QVariant>
+#include <QVector>
+#include <QVarLengthArray>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "SimpleXmlCore.h"
+#include "SimpleXmlPipeline.h"
+#include "SimpleXmlQueue.h"
+
+class QTimer;
+class SimpleXmlBind;
+class SimpleXmlIndex;
 
 /*
  *  Uncomment below macro to enable xml parsing extra debug
@@ -21,41 +41,324 @@ class SimpleXmlParser : public QObject
 {
     Q_OBJECT
 
-    QString m_StartTag;
-    QStringList m_TagsToSignal, m_parsedMessages;
-    int m_lastTagPos;
-    QString m_buffer;
-    QMutex muxMsgList;
+public:
+    /*!
+     * @brief A tag name prepared once to be searched many times.
+     *   Build one for each tag name you look up often and pass it to the static getters
+     *   instead of the tag string: the search patterns are computed here and not on every call.
+     */
+    class TagQuery
+    {
+        friend class SimpleXmlParser;
+
+        QString m_name;
+        QString m_startTag;     //"<name", the name must still be followed by '>' or a space
+        QString m_endTag;
+
+    public:
+        explicit TagQuery(const QString &tag);
+
+        QString name() const                                    { return m_name;                }
+        bool isEmpty() const                                    { return m_name.isEmpty();      }
+    };
+
+    /*!
+     * @brief A set of tag names prepared once to extract all their values in a single scan of a message.
+     *   The names are grouped by length so each tag found in the message is compared with a few
+     *   candidates only. A name given twice gets the same value in both places.
+     */
+    class TagSet
+    {
+        friend class SimpleXmlParser;
+
+        QStringList m_names;
+        QVector<QVector<int> > m_byLength;      //the indexes of the names, grouped by name length
+        QVector<int> m_duplicateOf;             //the index of the first occurrence of a repeated name, -1 if unique
+
+        int lookup(const QChar *name, int length) const;
+
+    public:
+        explicit TagSet(const QStringList &tags);
+
+        int count() const                                       { return m_names.size();        }
+        QString name(int i) const                               { return m_names.at(i);         }
+        int indexOf(const QString &tag) const                   { return m_names.indexOf(tag);  }
+    };
+
+    /*!
+     * @brief A path of element names compiled once, like "PhaseList/Phase[@phid='1']/Test".
+     *   A relative path starts from the children of the root element, a leading '/' starts from
+     *   the root element itself. A step can be "*" to match any name and can have predicates
+     *   on its attributes: [@name] (the attribute is there) or [@name='value'] (raw value, either quote).
+     */
+    class PathQuery
+    {
+        friend class SimpleXmlParser;
+
+        struct Predicate
+        {
+            QString attribute;
+            QString value;
+            bool hasValue;
+        };
+        struct Step
+        {
+            QString name;           //empty for "*"
+            QVector<Predicate> predicates;
+        };
+
+        QVector<Step> m_steps;
+        bool m_absolute;
+        bool m_valid;
+
+        bool parseStep(const QString &step);
+
+    public:
+        explicit PathQuery(const QString &path);
+
+        bool isValid() const                                    { return m_valid;               }
+        int length() const                                      { return m_steps.size();        }
+    };
+
+    /*!
+     * @brief An attribute of a start tag, both views point into the parsed message.
+     */
+    struct Attribute
+    {
+        QStringView name;
+        QStringView value;      //raw value without quotes, entities are not decoded
+    };
+
+    /*!
+     * @brief A flat list of attributes, filled in document order without allocating for the common tags.
+     */
+    typedef QVarLengthArray<Attribute, 16> AttributeList;
+
+    /*!
+     * @brief Walks the attributes of a start tag one at a time without allocating.
+     */
+    class AttributeIterator
+    {
+        friend class SimpleXmlParser;
+        friend class SimpleXmlIndex;
+        friend class SimpleXmlBind;
+
+        const QChar *m_pos, *m_end;
+        Attribute m_next;
+        bool m_hasNext;
+
+        AttributeIterator(const QChar *begin, const QChar *end);
+        void advance();
+
+    public:
+        AttributeIterator() : m_pos(0), m_end(0), m_hasNext(false) {}
+
+        bool hasNext() const                                    { return m_hasNext;             }
+        Attribute next();
+    };
+
+private:
+    friend class SimpleXmlIndex;
+    friend class SimpleXmlBind;
+
+    QStringList m_TagsToSignal;
+    SimpleXmlCore16 m_core;             //frames the data given to addData()
+    SimpleXmlCoreUtf8 m_utf8Core;       //frames the data given to addUtf8Data() on the UTF-8 bytes
+
+    /* a parsed message, kept in the encoding it was fed with and converted only when taken in the other one */
+    struct Message
+    {
+        QString text;
+        QByteArray utf8;
+        bool isUtf8;
+        int startTag;               //the index of the start tag enclosing it
+
+        Message() : isUtf8(false), startTag(0)                  {}
+        explicit Message(const QString &s) : text(s), isUtf8(false), startTag(0)    {}
+        explicit Message(const QByteArray &b) : utf8(b), isUtf8(true), startTag(0)  {}
+        explicit Message(SimpleXmlCore16::View v) : text(reinterpret_cast<const QChar *>(v.data()), int(v.size())), isUtf8(false), startTag(0)  {}
+        explicit Message(SimpleXmlCoreUtf8::View v) : utf8(v.data(), int(v.size())), isUtf8(true), startTag(0)                               {}
+        QString toString() const                                { return isUtf8 ? QString::fromUtf8(utf8) : text;   }
+        QByteArray toUtf8() const                               { return isUtf8 ? utf8 : text.toUtf8();             }
+    };
+    SimpleXmlQueue<Message> m_parsedMessages;
+
     int m_maxBufferSizeInBytes; //0 means unlmited and is the default
+    QStringList m_batch;        //the messages not yet emitted in E_DispatchBatch mode
+    QList<QByteArray> m_batchUtf8;
+    QTimer *m_batchTimer;       //created the first time a time window is used
+    int m_batchWindowMsecs;
+    int m_batchMaxMessages;
+    QPointer<QIODevice> m_device;       //the device given to attach()
+    int m_readChunkSize;
+    int m_queueHighWaterMark;           //0 means reads are never paused
+    std::atomic<bool> m_readPaused;
+    int m_mapWindowBytes;               //how much of a file parseFile() maps at a time
+    typedef SimpleXmlPipeline<Message, QVariant> ExtractionPipeline;
+    std::unique_ptr<ExtractionPipeline> m_pipeline;     //set by setExtractionPipeline()
+    int m_spillThreshold;               //0 means messages are never spilled
+    QString m_spillDirectory;
+    QSharedPointer<QFile> m_spillFile;  //the beginning of the message in progress, once spilled
 
-    static bool findStartTagDelimiters(const QString &msg, const QString &tag, int offset, int &startIdx, int &endIdx);
-    static QString unquoteString(const QString &s);
+    static bool findStartTagDelimiters(const QString &msg, const TagQuery &tag, int offset, int &startIdx, int &endIdx);
+    static QMap<QString, QString> parseProperties(const QString &msg, int beginidx, int endidx);
+
+    /* a piece of markup found by nextMarkup(), offsets go from the '<' to past the '>' */
+    struct Markup
+    {
+        enum Kind { E_StartTag, E_EmptyElementTag, E_EndTag, E_OtherMarkup };
+        Kind kind;
+        int begin, end;
+        int nameBegin, nameEnd;
+        int attributesEnd;          //the attributes text goes from nameEnd to here
+    };
+    static bool nextMarkup(const QChar *data, int size, int from, Markup &markup);
+    static bool stepMatches(const QChar *data, const Markup &markup, const PathQuery::Step &step);
+
+    /* the start and end tags of a TagQuery found in a chunk of a message */
+    struct TagCandidates
+    {
+        QVector<int> starts;        //the '<' of the start tags
+        QVector<int> closes;        //the '>' closing each start tag, -1 if it is not closed
+        QVector<int> ends;          //the '<' of the end tags
+    };
+    static void findTagCandidates(const QString &msg, const TagQuery &tag, int from, int to, TagCandidates &found);
+
+    static int s_parallelMinChunk;  //the smallest part of a message worth a thread of its own
+    static int parallelChunkCount(int size, int threads);
+    static int chunkBegin(int size, int chunks, int chunk)     { return int(qint64(size) * chunk / chunks);    }
+    static void runInChunks(int size, int chunks, const std::function<void(int chunk, int from, int to)> &work);
+
+    template <typename Core>
+    int frameCore(Core &core, const typename Core::View::value_type *external=0, int externalSize=0);
+    template <typename Core>
+    void feedCore(Core &core, const typename Core::View::value_type *data, int size);
+    template <typename Core>
+    int bufferRoom(Core &core);
+    template <typename Core>
+    void spillMessageHead(Core &core);
+    void finishSpill(const Message &tail);
+    void dispatchMessage(const Message &msg);
+    void emitParsedMessage(const Message &msg);
+    bool enqueueMessage(const Message &msg);
+    bool bufferLimitReached(int bufferedBytes);
+    void readDevice();
+    void resumeReadingIfDrained();
+    void deliverExtracted();
+    QString startTagName(int startTag) const;
+    qint64 frameMappedFile(QFile &file, bool sequentialHint);
 
 public:
     explicit SimpleXmlParser(QObject *parent=0);
 
-    enum notificationMode { E_NotifyOnly, E_DispatchMessage, E_DispatchMessageAndDelete, E_NotifyAndDispatch };
-    enum ParseErrorEnumType { E_EndTagNotMatched, E_MessageTooBig };
+    enum notificationMode { E_NotifyOnly, E_DispatchMessage, E_DispatchMessageAndDelete, E_NotifyAndDispatch, E_DispatchBatch };
+    enum ParseErrorEnumType { E_EndTagNotMatched, E_MessageTooBig, E_QueueFull, E_SpillFailed };
+    enum QueueFullPolicy { E_QueueDropOldest, E_QueueReject, E_QueueBlock };
+    enum BufferFullPolicy { E_BufferReject, E_BufferResync };
+    enum ValueError { E_ValueOk, E_ValueNotFound, E_ValueInvalid, E_ValueOutOfRange };
+    typedef std::function<QVariant(QStringView msg)> ExtractionFunction;
 
     void setNotificationMode(const notificationMode aMode)      { m_notifyMode = aMode;         }
-    void setStartTag(const QString &aTag)                       { m_StartTag = aTag;            }
-    void addTagToFind(const QString &aTag)                      { m_TagsToSignal.append(aTag);  }
+    void setStartTag(const QString &aTag);
+    void addStartTag(const QString &aTag);
+    void addTagToFind(const QString &aTag);
     void addData(const QString &aMsgpart);
-    QString getNextMessage();
+    void addUtf8Data(const QByteArray &aMsgpart);
+    void addUtf8Data(const char *data, int size);
+    bool parseFile(const QString &path, bool sequentialHint=true);
+    QString getNextMessage(QString *startTag=0);
+    QByteArray getNextMessageUtf8(QString *startTag=0);
+    QStringList takeMessages(int maxCount=-1);
+    QList<QByteArray> takeMessagesUtf8(int maxCount=-1);
+    SimpleXmlIndex getNextIndexedMessage();
     bool hasPendingMessages();
     int  getMaxBufferSize() const                               { return m_maxBufferSizeInBytes;        }
     void setMaxBufferSize(int sizeInBytes);
+    BufferFullPolicy getBufferFullPolicy() const                { return m_bufferFullPolicy;            }
+    void setBufferFullPolicy(BufferFullPolicy aPolicy)          { m_bufferFullPolicy = aPolicy;         }
+    qint64 getSkippedBytes() const;
+    int  getSpillThreshold() const                              { return m_spillThreshold;              }
+    void setSpillThreshold(int sizeInBytes, const QString &directory=QString());
     void emptyBuffer();
     QString getCurrentBuffer() const;
+    QByteArray getCurrentBufferUtf8() const;
+    int  getQueueCapacity() const                               { return m_parsedMessages.capacity();   }
+    void setQueueCapacity(int capacity);
+    QueueFullPolicy getQueueFullPolicy() const                  { return m_queueFullPolicy;             }
+    void setQueueFullPolicy(QueueFullPolicy aPolicy)            { m_queueFullPolicy = aPolicy;          }
+    void setBatchWindow(int msecs, int maxMessages=0);
+    void attach(QIODevice *device);
+    void detach();
+    QIODevice *attachedDevice() const                           { return m_device;                      }
+    int  getReadChunkSize() const                               { return m_readChunkSize;               }
+    void setReadChunkSize(int bytes);
+    int  getQueueHighWaterMark() const                          { return m_queueHighWaterMark;          }
+    void setQueueHighWaterMark(int messages);
+    bool isReadingPaused() const                                { return m_readPaused;                  }
+    int  getBatchWindow() const                                 { return m_batchWindowMsecs;             }
+    int  getBatchMaxMessages() const                            { return m_batchMaxMessages;            }
+    void setExtractionPipeline(const ExtractionFunction &extract, int threads=0);
+    int  getExtractionThreads() const                           { return m_pipeline ? m_pipeline->threadCount() : 0; }
+    void waitForExtraction();
 
     static QString      getTagValue          (const QString &msg, const QString &tag, int beginidx=0, QString defaultValue="");
+    static QString      getTagValue          (const QString &msg, const TagQuery &tag, int beginidx=0, QString defaultValue="");
     static QString      getDecodedTagValue   (const QString &msg, const QString &tag, int beginidx=0, QString defaultValue="");
+    static QString      getDecodedTagValue   (const QString &msg, const TagQuery &tag, int beginidx=0, QString defaultValue="");
 
-    static QStringList  getTagsValues        (const QString &msg, const QString &tag);
+    /*
+     * Typed getters: the value is converted straight from the message text, no string is created.
+     * T can be int, uint, qint64, quint64, double or bool ("true", "false", "1" or "0" as in XML Schema).
+     * Whitespace around the value is ignored. When the tag or the attribute is not found or the value
+     * does not convert, defaultValue is returned and error, if given, tells why.
+     */
+    template <typename T> static T          getTagValueAs       (const QString &msg, const QString &tag, int beginidx=0, T defaultValue=T(), ValueError *error=0);
+    template <typename T> static T          getTagValueAs       (const QString &msg, const TagQuery &tag, int beginidx=0, T defaultValue=T(), ValueError *error=0);
+    template <typename T> static T          getTagAttributeAs   (const QString &msg, const QString &tag, const QString &attribute, int beginidx=0, T defaultValue=T(), ValueError *error=0);
+    template <typename T> static T          getTagAttributeAs   (const QString &msg, const TagQuery &tag, const QString &attribute, int beginidx=0, T defaultValue=T(), ValueError *error=0);
+    template <typename T> static ValueError parseValue          (QStringView text, T &value);
+
+    static QStringList  getTagsValues        (const QString &msg, const QString &tag, QList<int> *endOffsets=0);
+    static QStringList  getTagsValues        (const QString &msg, const TagQuery &tag, QList<int> *endOffsets=0);
+    static QStringList  getTagsValuesParallel(const QString &msg, const QString &tag, int threads=0, QList<int> *endOffsets=0);
+    static QStringList  getTagsValuesParallel(const QString &msg, const TagQuery &tag, int threads=0, QList<int> *endOffsets=0);
     static QStringList  getDecodedTagsValues (const QString &msg, const QString &tag);
+    static QStringList  getDecodedTagsValues (const QString &msg, const TagQuery &tag);
 
     static QMap<QString, QString>           getTagProperties    (const QString &msg, const QString &tag, int beginidx=0);
-    static QList<QMap<QString, QString> >   getTagsProperties   (const QString &msg, const QString &tag);
+    static QMap<QString, QString>           getTagProperties    (const QString &msg, const TagQuery &tag, int beginidx=0);
+    static QList<QMap<QString, QString> >   getTagsProperties   (const QString &msg, const QString &tag, QList<int> *endOffsets=0);
+    static QList<QMap<QString, QString> >   getTagsProperties   (const QString &msg, const TagQuery &tag, QList<int> *endOffsets=0);
+
+    static QStringList  getTagSetValues      (const QString &msg, const QStringList &tags, QList<QMap<QString, QString> > *attributes=0);
+    static QStringList  getTagSetValues      (const QString &msg, const TagSet &tags, QList<QMap<QString, QString> > *attributes=0);
+
+    static QStringList  select               (const QString &msg, const QString &path);
+    static QStringList  select               (const QString &msg, const PathQuery &path);
+
+    /*
+     * Zero-copy variants: the returned views point into msg and stay valid only as long as msg
+     * is alive and is not modified, call toString() on them to keep a value longer.
+     * A not found tag gives a null view, an empty tag an empty (not null) one.
+     * Passing a temporary message is not allowed as the views would be dangling.
+     */
+    static QStringView                  getTagValueView     (const QString &msg, const TagQuery &tag, int beginidx=0);
+    static QVector<QStringView>         getTagsValuesViews  (const QString &msg, const TagQuery &tag, QList<int> *endOffsets=0);
+    static QVector<QStringView>         getTagsValuesViewsParallel(const QString &msg, const TagQuery &tag, int threads=0, QList<int> *endOffsets=0);
+    static AttributeIterator            getTagAttributes    (const QString &msg, const TagQuery &tag, int beginidx=0);
+    static bool                         getTagAttributes    (const QString &msg, const TagQuery &tag, AttributeList &attributes, int beginidx=0);
+    static QStringView                  getTagAttributeView (const QString &msg, const TagQuery &tag, const QString &attribute, int beginidx=0);
+    static QVector<QStringView>         selectViews         (const QString &msg, const PathQuery &path);
+    static QVector<QStringView>         getTagSetValuesViews(const QString &msg, const TagSet &tags, QList<QMap<QString, QString> > *attributes=0);
+
+    static QStringView                  getTagValueView     (QString &&msg, const TagQuery &tag, int beginidx=0) = delete;
+    static QVector<QStringView>         getTagsValuesViews  (QString &&msg, const TagQuery &tag, QList<int> *endOffsets=0) = delete;
+    static QVector<QStringView>         getTagsValuesViewsParallel(QString &&msg, const TagQuery &tag, int threads=0, QList<int> *endOffsets=0) = delete;
+    static AttributeIterator            getTagAttributes    (QString &&msg, const TagQuery &tag, int beginidx=0) = delete;
+    static bool                         getTagAttributes    (QString &&msg, const TagQuery &tag, AttributeList &attributes, int beginidx=0) = delete;
+    static QStringView                  getTagAttributeView (QString &&msg, const TagQuery &tag, const QString &attribute, int beginidx=0) = delete;
+    static QVector<QStringView>         selectViews         (QString &&msg, const PathQuery &path) = delete;
+    static QVector<QStringView>         getTagSetValuesViews(QString &&msg, const TagSet &tags, QList<QMap<QString, QString> > *attributes=0) = delete;
 
     /*!
      * @brief Decode XML entities.
@@ -68,20 +371,60 @@ public:
      *   Convert &, >, <, ", ' and non-ASCII characters (if required) to XML entities.
      */
     static QString encodeEntities(const QString &s, bool encodeNonAscii=false);
+    static void appendEncodedEntities(QString &out, const QString &s, bool encodeNonAscii=false);
 
     /* TEST FUNCTIONS */
     static void test_getTag();
     static void test_getProperty();
     static void test_addData();
+    static void test_index();
+    static void test_scan();
+    static void test_core();
+    static void test_attach();
+    static void test_parseFile();
+    static void test_pipeline();
+    static void test_parallelScan();
+    static void test_startTags();
+    static void test_resync();
+    static void test_spill();
+    static void test_typedValues();
+    static void test_bind();
+
+    /* BENCHMARK FUNCTIONS */
+    static void bench_decodeEntities();
+    static void bench_encodeEntities();
+    static void bench_getTagProperties();
+    static void bench_select();
+    static void bench_getTagSetValues();
+    static void bench_messageQueue();
+    static void bench_addUtf8Data();
+    static void bench_instanceFootprint();
+    static void bench_attach();
+    static void bench_parseFile();
+    static void bench_pipeline();
+    static void bench_parallelScan();
+    static void bench_spill();
+    static void bench_typedValues();
+    static void bench_bind();
+
+public slots:
+    void flushBatch();
 
 signals:
     void foundTag(QString tag, QString value);
     void messageCompleted();
     void parsedMessage(QString msg);
+    void parsedMessages(QStringList msgs);
+    void parsedMessageUtf8(QByteArray msg);
+    void parsedMessagesUtf8(QList<QByteArray> msgs);
+    void parsedMessageFile(QSharedPointer<QFile> file);
     void parseErrorFound(ParseErrorEnumType);
+    void messageExtracted(QVariant result);
 
 protected:
     notificationMode m_notifyMode;
+    QueueFullPolicy m_queueFullPolicy;
+    BufferFullPolicy m_bufferFullPolicy;
 };
 
 #endif // SIMPLEXMLPARSER_H
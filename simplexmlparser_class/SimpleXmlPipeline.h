@@ -0,0 +1,188 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLPIPELINE_H
+#define SIMPLEXMLPIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SimpleXmlQueue.h"
+
+/*!
+ * @brief Runs a function on a stream of inputs with a pool of worker threads and hands the results
+ *   back in the order the inputs were submitted.
+ *   The jobs wait in a SimpleXmlQueue every idle worker pops from, so a worker stuck on a long job never
+ *   holds back the others. Every job owns the slot of a ring matching its sequence number where the worker
+ *   stores the result, the consumer takes the results from the ring while the slots in order are ready.
+ *   Submitting and delivering must be done by the same thread (the consumer). When the ring is full the
+ *   consumer does not wait: it runs queued jobs itself (see help()) until the oldest results can be delivered.
+ */
+template <typename Input, typename Result>
+class SimpleXmlPipeline
+{
+public:
+    typedef std::function<Result(const Input &)> Function;
+
+    /*!
+     * @brief Starts \a threads workers running \a function, at most \a capacity results are kept undelivered.
+     *   \a resultReady is called by a worker when the result the consumer is waiting for gets ready.
+     */
+    SimpleXmlPipeline(const Function &function, int threads, int capacity, const std::function<void()> &resultReady)
+        : m_function(function),
+          m_resultReady(resultReady),
+          m_jobs(capacity),
+          m_slots(size_t(m_jobs.capacity())),
+          m_submitted(0),
+          m_delivered(0),
+          m_stopping(false)
+    {
+        for (int i = 0; i < threads; i++)
+            m_workers.push_back(std::thread(&SimpleXmlPipeline::work, this));
+    }
+
+    /*!
+     * @brief Stops the workers once they finish the job in hand, the results not delivered yet are lost.
+     */
+    ~SimpleXmlPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (size_t i = 0; i < m_workers.size(); i++)
+            m_workers[i].join();
+    }
+
+    int threadCount() const                                     { return int(m_workers.size());    }
+
+    /*!
+     * @brief Queues \a input for the workers.
+     * @return false if as many results as the capacity are waiting to be delivered, \a input is left untouched
+     */
+    bool trySubmit(Input &input)
+    {
+        if (m_submitted - m_delivered.load() >= m_slots.size())
+            return false;
+
+        Job job = { m_submitted, std::move(input) };
+        m_jobs.tryPush(job);    //it can not be full, it holds fewer jobs than the undelivered results
+        m_submitted++;
+        {
+            //taken only so a worker can not miss the notification between its check and its wait
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_wake.notify_one();
+        return true;
+    }
+
+    /*!
+     * @brief Runs one queued job on the calling thread.
+     * @return false if no job was waiting
+     */
+    bool help()
+    {
+        Job job;
+        if (!m_jobs.tryPop(job))
+            return false;
+        run(job);
+        return true;
+    }
+
+    /*!
+     * @brief Passes to \a receiver the results ready in submission order, it stops at the first one not ready.
+     * @return the number of results delivered
+     */
+    template <typename Deliver>
+    int deliver(Deliver &&receiver)
+    {
+        int count = 0;
+        size_t seq = m_delivered.load();
+        while (seq != m_submitted) {
+            Slot &slot = m_slots[seq & (m_slots.size() - 1)];
+            if (!slot.ready.load())
+                break;
+            Result result = std::move(slot.result);
+            slot.result = Result();
+            slot.ready.store(false, std::memory_order_relaxed);
+            //published before looking at the next slot, so its worker sees it and calls resultReady
+            m_delivered.store(++seq);
+            receiver(result);
+            count++;
+        }
+        return count;
+    }
+
+    /*!
+     * @brief Whether every result submitted has been delivered.
+     */
+    bool isDone() const
+    {
+        return m_delivered.load() == m_submitted;
+    }
+
+private:
+    struct Job
+    {
+        size_t seq;
+        Input input;
+    };
+
+    struct Slot
+    {
+        std::atomic<bool> ready;
+        Result result;
+
+        Slot() : ready(false)                                   {}
+    };
+
+    Function m_function;
+    std::function<void()> m_resultReady;
+    SimpleXmlQueue<Job> m_jobs;
+    std::vector<Slot> m_slots;              //as many as the jobs queue capacity, a power of two
+    size_t m_submitted;                     //written by the consumer only
+    std::atomic<size_t> m_delivered;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stopping;
+
+    SimpleXmlPipeline(const SimpleXmlPipeline &);
+    SimpleXmlPipeline &operator=(const SimpleXmlPipeline &);
+
+    void run(Job &job)
+    {
+        Slot &slot = m_slots[job.seq & (m_slots.size() - 1)];
+        slot.result = m_function(job.input);
+        slot.ready.store(true);
+        //either this sees the consumer waiting for this job or the consumer sees the result ready
+        if (m_delivered.load() == job.seq && m_resultReady)
+            m_resultReady();
+    }
+
+    void work()
+    {
+        Job job;
+        while (!m_stopping) {
+            if (m_jobs.tryPop(job)) {
+                run(job);
+                job.input = Input();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.isEmpty(); });
+        }
+    }
+};
+
+#endif // SIMPLEXMLPIPELINE_H
@@ -0,0 +1,168 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLQUEUE_H
+#define SIMPLEXMLQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <utility>
+
+/*!
+ * @brief A bounded lock-free queue, any number of threads can push and pop concurrently.
+ *   Every cell carries a sequence number telling whether it is ready to be written or read
+ *   for a given lap of the ring, so producers and consumers only contend on the cell they claim
+ *   (D. Vyukov's bounded MPMC queue). The capacity is rounded up to a power of two.
+ *   The ring is allocated by the first push, an idle queue costs only the object itself.
+ */
+template <typename T>
+class SimpleXmlQueue
+{
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::atomic<Cell *> m_cells;
+    size_t m_mask;
+    //the two positions are written by different threads, keep them on different cache lines
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+
+    SimpleXmlQueue(const SimpleXmlQueue &);
+    SimpleXmlQueue &operator=(const SimpleXmlQueue &);
+
+public:
+    explicit SimpleXmlQueue(int capacity)
+        : m_cells(0),
+          m_mask(0)
+    {
+        setCapacity(capacity);
+    }
+
+    ~SimpleXmlQueue()
+    {
+        delete[] m_cells.load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * @brief Reallocates the ring, dropping what it holds. It must not be used by other threads meanwhile.
+     */
+    void setCapacity(int capacity)
+    {
+        size_t size = 2;
+        while (size < size_t(capacity))
+            size <<= 1;
+
+        delete[] m_cells.load(std::memory_order_relaxed);
+        m_cells.store(0, std::memory_order_relaxed);
+        m_mask = size - 1;
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    int capacity() const
+    {
+        return int(m_mask + 1);
+    }
+
+    /*!
+     * @brief Appends \a value unless the queue is full.
+     * @return false if the queue is full, \a value is left untouched
+     */
+    bool tryPush(T &value)
+    {
+        Cell *cells = m_cells.load(std::memory_order_acquire);
+        if (!cells)
+            cells = allocate();
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false;   //the cell still holds the value of the previous lap
+            }
+            else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * @brief Takes the oldest value.
+     * @return false if the queue is empty
+     */
+    bool tryPop(T &value)
+    {
+        Cell *cells = m_cells.load(std::memory_order_acquire);
+        if (!cells)
+            return false;
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false;   //nothing was written in the cell for this lap yet
+            }
+            else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * @brief The number of values in the queue, only a hint while other threads are using it.
+     */
+    int sizeHint() const
+    {
+        size_t enq = m_enqueuePos.load(std::memory_order_acquire);
+        size_t deq = m_dequeuePos.load(std::memory_order_acquire);
+        return enq > deq ? int(enq - deq) : 0;
+    }
+
+    bool isEmpty() const
+    {
+        return sizeHint() == 0;
+    }
+
+private:
+    /* several producers may race to allocate the ring, only the first one publishes it */
+    Cell *allocate()
+    {
+        size_t size = m_mask + 1;
+        Cell *fresh = new Cell[size];
+        for (size_t i = 0; i < size; i++)
+            fresh[i].sequence.store(i, std::memory_order_relaxed);
+
+        Cell *expected = 0;
+        if (m_cells.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+            return fresh;
+        delete[] fresh;
+        return expected;
+    }
+};
+
+#endif // SIMPLEXMLQUEUE_H
@@ -0,0 +1,257 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):																	*
+ *				Francesco Lamonica		<f.lamonica@netresults.it>				*
+ ********************************************************************************/
+
+#ifndef SIMPLEXMLSCAN_H
+#define SIMPLEXMLSCAN_H
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ *  Vectorized search of the structural characters (<, >, /, quotes, &) in UTF-16 text.
+ *  The kernel is chosen once at runtime: AVX2 or SSE2 on x86, NEON on aarch64 and a scalar
+ *  loop everywhere else. It does not depend on Qt so it can be used on any UTF-16 buffer.
+ *  Define SXML_NO_SIMD to always use the scalar loop.
+ */
+#if !defined(SXML_NO_SIMD)
+#  if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define SXML_SIMD_X86 1
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#      include <intrin.h>
+#      define SXML_TARGET_AVX2
+#    else
+#      define SXML_TARGET_AVX2 __attribute__((target("avx2")))
+#    endif
+#  elif defined(__aarch64__) || defined(_M_ARM64)
+#    define SXML_SIMD_NEON 1
+#    include <arm_neon.h>
+#  endif
+#endif
+
+class SimpleXmlScan
+{
+public:
+    enum Kernel { E_Scalar, E_SSE2, E_AVX2, E_NEON };
+
+    /* the largest number of characters findFirstOf() can look for at once */
+    enum { MaxChars = 4 };
+
+    typedef int (*FindFunction)(const char16_t *data, int size, int from, const char16_t *chars, int count);
+
+    /*!
+     * @brief Finds the first of \a count (1 to MaxChars) \a chars in \a data starting from \a from.
+     * @return the index of the character found, -1 if none
+     */
+    static int findFirstOf(const char16_t *data, int size, int from, const char16_t *chars, int count)
+    {
+        //the kernels keep one register per character and compare the first one unconditionally
+        assert(count >= 1 && count <= MaxChars);
+        if (count <= 0)
+            return -1;
+        return activeFunction()(data, size, from, chars, count);
+    }
+
+    static int indexOf(const char16_t *data, int size, int from, char16_t c)
+    {
+        return activeFunction()(data, size, from, &c, 1);
+    }
+
+    /*!
+     * @brief Finds \a pattern in \a data: its first character is searched with the kernel, the rest compared in place.
+     */
+    static int indexOf(const char16_t *data, int size, int from, const char16_t *pattern, int patternLen)
+    {
+        if (patternLen <= 0)
+            return from <= size ? from : -1;
+
+        const int last = size - patternLen;
+        FindFunction find = activeFunction();
+        int pos = from;
+        while (pos <= last) {
+            pos = find(data, last + 1, pos, pattern, 1);
+            if (pos < 0)
+                return -1;
+            if (memcmp(data + pos + 1, pattern + 1, (patternLen - 1) * sizeof(char16_t)) == 0)
+                return pos;
+            pos++;
+        }
+        return -1;
+    }
+
+    static Kernel activeKernel()
+    {
+        static const Kernel kernel = detectKernel();
+        return kernel;
+    }
+
+    static bool isKernelSupported(Kernel kernel)
+    {
+        switch (kernel) {
+        case E_Scalar:
+            return true;
+#if defined(SXML_SIMD_X86)
+        case E_SSE2:
+            return true;
+        case E_AVX2:
+            return cpuHasAvx2();
+#endif
+#if defined(SXML_SIMD_NEON)
+        case E_NEON:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /* the function implementing \a kernel, it must be supported by the CPU (used by the tests to compare kernels) */
+    static FindFunction kernelFunction(Kernel kernel)
+    {
+        switch (kernel) {
+#if defined(SXML_SIMD_X86)
+        case E_SSE2:
+            return findFirstOfSse2;
+        case E_AVX2:
+            return findFirstOfAvx2;
+#endif
+#if defined(SXML_SIMD_NEON)
+        case E_NEON:
+            return findFirstOfNeon;
+#endif
+        default:
+            return findFirstOfScalar;
+        }
+    }
+
+    static int findFirstOfScalar(const char16_t *data, int size, int from, const char16_t *chars, int count)
+    {
+        for (int i = from < 0 ? 0 : from; i < size; i++) {
+            char16_t c = data[i];
+            for (int k = 0; k < count; k++) {
+                if (c == chars[k])
+                    return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    static FindFunction activeFunction()
+    {
+        static const FindFunction function = kernelFunction(activeKernel());
+        return function;
+    }
+
+    static Kernel detectKernel()
+    {
+#if defined(SXML_SIMD_X86)
+        return cpuHasAvx2() ? E_AVX2 : E_SSE2;
+#elif defined(SXML_SIMD_NEON)
+        return E_NEON;
+#else
+        return E_Scalar;
+#endif
+    }
+
+    static int countTrailingZeros(unsigned int v)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long idx;
+        _BitScanForward(&idx, v);
+        return int(idx);
+#else
+        return __builtin_ctz(v);
+#endif
+    }
+
+#if defined(SXML_SIMD_X86)
+    static bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    static int findFirstOfSse2(const char16_t *data, int size, int from, const char16_t *chars, int count)
+    {
+        int i = from < 0 ? 0 : from;
+        __m128i needles[MaxChars];
+        for (int k = 0; k < count; k++)
+            needles[k] = _mm_set1_epi16(short(chars[k]));
+
+        for (; i + 8 <= size; i += 8) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i hits = _mm_cmpeq_epi16(block, needles[0]);
+            for (int k = 1; k < count; k++)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi16(block, needles[k]));
+            unsigned int mask = unsigned(_mm_movemask_epi8(hits));
+            if (mask)
+                return i + countTrailingZeros(mask) / 2;
+        }
+        return findFirstOfScalar(data, size, i, chars, count);
+    }
+
+    SXML_TARGET_AVX2
+    static int findFirstOfAvx2(const char16_t *data, int size, int from, const char16_t *chars, int count)
+    {
+        int i = from < 0 ? 0 : from;
+        __m256i needles[MaxChars];
+        for (int k = 0; k < count; k++)
+            needles[k] = _mm256_set1_epi16(short(chars[k]));
+
+        for (; i + 16 <= size; i += 16) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i hits = _mm256_cmpeq_epi16(block, needles[0]);
+            for (int k = 1; k < count; k++)
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi16(block, needles[k]));
+            unsigned int mask = unsigned(_mm256_movemask_epi8(hits));
+            if (mask)
+                return i + countTrailingZeros(mask) / 2;
+        }
+        return findFirstOfSse2(data, size, i, chars, count);
+    }
+#endif
+
+#if defined(SXML_SIMD_NEON)
+    static int findFirstOfNeon(const char16_t *data, int size, int from, const char16_t *chars, int count)
+    {
+        int i = from < 0 ? 0 : from;
+        uint16x8_t needles[MaxChars];
+        for (int k = 0; k < count; k++)
+            needles[k] = vdupq_n_u16(chars[k]);
+
+        for (; i + 8 <= size; i += 8) {
+            uint16x8_t block = vld1q_u16(reinterpret_cast<const uint16_t *>(data + i));
+            uint16x8_t hits = vceqq_u16(block, needles[0]);
+            for (int k = 1; k < count; k++)
+                hits = vorrq_u16(hits, vceqq_u16(block, needles[k]));
+            //narrow every 16 bit lane to 8 bits so the whole block fits in a 64 bit mask
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(hits)), 0);
+            if (mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+                unsigned long idx;
+                _BitScanForward64(&idx, mask);
+                return i + int(idx) / 8;
+#else
+                return i + __builtin_ctzll(mask) / 8;
+#endif
+            }
+        }
+        return findFirstOfScalar(data, size, i, chars, count);
+    }
+#endif
+};
+
+#endif // SIMPLEXMLSCAN_H
@@ -1,3 +1,11 @@
 INCLUDEPATH += $$PWD
-HEADERS += $$PWD/SimpleXmlParser.h
-SOURCES += $$PWD/SimpleXmlParser.cpp
+CONFIG += c++17
+HEADERS += $$PWD/SimpleXmlParser.h \
+           $$PWD/SimpleXmlBind.h \
+           $$PWD/SimpleXmlIndex.h \
+           $$PWD/SimpleXmlScan.h \
+           $$PWD/SimpleXmlCore.h \
+           $$PWD/SimpleXmlQueue.h \
+           $$PWD/SimpleXmlPipeline.h
+SOURCES += $$PWD/SimpleXmlParser.cpp \
+           $$PWD/SimpleXmlIndex.cpp
@@ -0,0 +1,985 @@
+/********************************************************************************
+ *   Copyright (C) 2012-2016 by NetResults S.r.l. ( http://www.netresults.it )  *
+ *   Author(s):                                                                 *
+ *              Francesco Lamonica		<f.lamonica@netresults.it>              *
+ ********************************************************************************/
+
+#include "SimpleXmlParser.h"
+#include "SimpleXmlBind.h"
+#include "SimpleXmlIndex.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QThread>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+ *  Throughput benchmarks, each one compares the current implementation with the previous one.
+ *  They are run by the tester with the --bench option.
+ */
+
+/*!
+  \brief runs \a f on \a input for at least 200ms, the result of \a f must have a size()
+  \return the throughput in MB/s of UTF-16 text
+  */
+template <typename Function>
+static double
+measureThroughput(Function f, const QString &input)
+{
+    QElapsedTimer timer;
+    qint64 iterations = 0;
+    int sink = 0;
+    timer.start();
+    do {
+        sink += f(input).size();
+        iterations++;
+    } while (timer.elapsed() < 200);
+    qint64 nsecs = timer.nsecsElapsed();
+    Q_UNUSED(sink);
+
+    return double(input.size() * sizeof(QChar)) * iterations / nsecs * 1000.0;
+}
+
+
+
+static void
+reportThroughput(const char *name, double before, double after)
+{
+    qDebug() << name << ": before" << before << "MB/s, after" << after << "MB/s, speedup" << after / before;
+}
+
+
+
+/*
+ *  decodeEntities() as it was before the single pass decoder
+ */
+static QString
+legacyDecodeEntities(const QString &s)
+{
+    QString ret(s);
+    ret.replace("&amp;", "&").replace("&gt;", ">").replace("&lt;", "<").replace("&quot;", "\"").replace("&apos;", "'");
+
+    // remove invalid chars (replacement char has U+FFFD as unicode code)
+    ret.replace(QChar(0xFFFD), " ");
+
+    QRegularExpression re("&#([0-9]+);|&#x([0-9A-F]+);",
+                          QRegularExpression::CaseInsensitiveOption | QRegularExpression::UseUnicodePropertiesOption);
+
+    QRegularExpressionMatchIterator i = re.globalMatch(ret);
+    int offset = 0;
+    while (i.hasNext()) {
+        QRegularExpressionMatch match = i.next();
+        QString matched = match.captured(0);
+        int position = match.capturedStart();
+        int length = matched.length();
+        QString decoded = QChar(matched.startsWith("&#x") ? match.captured(2).toInt(0, 16) : match.captured(1).toInt(0, 10));
+
+        ret.replace(position + offset, length, decoded);
+        offset += decoded.length() - length;
+    }
+
+    return ret;
+}
+
+
+
+void
+SimpleXmlParser::bench_decodeEntities()
+{
+    QString dense, plain;
+    for (int i = 0; i < 1000; i++) {
+        dense += "alice &lt; bob&#x2019;s mom &amp; '3 &gt; 1' &#233;&#224;&#8364; &quot;q&quot; ";
+        plain += "alice and bob went to the market to buy some apples, pears and oranges. ";
+    }
+
+    //the two implementations agree as long as there are no escaped entities and no code points above U+FFFF
+    Q_ASSERT(decodeEntities(dense) == legacyDecodeEntities(dense));
+    Q_ASSERT(decodeEntities(plain) == legacyDecodeEntities(plain));
+
+    reportThroughput("decodeEntities, entity dense text", measureThroughput(legacyDecodeEntities, dense), measureThroughput(decodeEntities, dense));
+    reportThroughput("decodeEntities, text without entities", measureThroughput(legacyDecodeEntities, plain), measureThroughput(decodeEntities, plain));
+}
+
+
+
+/*
+ *  encodeEntities() as it was before the single pass encoder
+ */
+static QString
+legacyEncodeEntities(const QString &s, bool encodeNonAscii)
+{
+    QString ret(s);
+    if (encodeNonAscii)
+    {
+        uint len = ret.length();
+        uint i = 0;
+        while(i < len)
+        {
+            if(ret[i].unicode() > 128)
+            {
+                QString rp = "&#x" + QString::number(ret[i].unicode(), 16) + ";";
+                ret.replace(i, 1, rp);
+                len += rp.length() -1;
+                i += rp.length();
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+    ret.replace("&", "&amp;").replace(">", "&gt;").replace("<", "&lt;").replace("\"", "&quot;").replace("'", "&apos;");
+    return ret;
+}
+
+
+
+static QString
+legacyEncodeNonAscii(const QString &s)
+{
+    return legacyEncodeEntities(s, true);
+}
+
+
+
+static QString
+encodeNonAscii(const QString &s)
+{
+    return SimpleXmlParser::encodeEntities(s, true);
+}
+
+
+
+static QString
+appendEncodedNonAscii(const QString &s)
+{
+    static QString buffer;
+    buffer.resize(0);       //keeps the memory of the previous encodings
+    SimpleXmlParser::appendEncodedEntities(buffer, s, true);
+    return buffer;
+}
+
+
+
+void
+SimpleXmlParser::bench_encodeEntities()
+{
+    QString localized;
+    for (int i = 0; i < 1000; i++) {
+        localized += QString::fromUtf8("Perché l'attività è già finita? Größe & Übermaß <3 \"città\" ");
+    }
+
+    //the previous encoder escaped the '&' of its own numeric entities, the decoder handled it by decoding twice
+    Q_ASSERT(decodeEntities(decodeEntities(legacyEncodeNonAscii(localized))) == localized);
+    Q_ASSERT(decodeEntities(encodeNonAscii(localized)) == localized);
+    Q_ASSERT(appendEncodedNonAscii(localized) == encodeNonAscii(localized));
+
+    double before = measureThroughput(legacyEncodeNonAscii, localized);
+    reportThroughput("encodeEntities, localized text", before, measureThroughput(encodeNonAscii, localized));
+    reportThroughput("appendEncodedEntities, reused buffer", before, measureThroughput(appendEncodedNonAscii, localized));
+}
+
+
+
+/*
+ *  getTagProperties() as it was before the attribute tokenizer
+ */
+static QMap<QString, QString>
+legacyGetTagProperties(const QString &i_msg, const QString &i_tag)
+{
+    QMap<QString, QString> map;
+    SimpleXmlParser::TagQuery query(i_tag);
+    QString starttag = "<" + query.name();
+    int idx = i_msg.indexOf(starttag + " ");
+    int endidx = i_msg.indexOf(">", idx);
+    if (idx < 0 || endidx < 0)
+        return map;
+
+    QString tmpprop = i_msg.mid(idx + starttag.length(), endidx - idx - starttag.length());
+    tmpprop.replace(QRegularExpression("\\s*=\\s*"),"=");
+
+    QStringList sl;
+    QRegularExpression rx("(\\w+(?:(?:-\\w+)*)?=\".*\")", QRegularExpression::UseUnicodePropertiesOption);
+    QRegularExpressionMatchIterator rxMatchIterator = rx.globalMatch(tmpprop.trimmed());
+    while (rxMatchIterator.hasNext()) {
+        QRegularExpressionMatch match = rxMatchIterator.next();
+        if (match.hasMatch() && !match.captured(0).isEmpty()) {
+            sl << match.captured(0);
+        }
+    }
+    QRegularExpression rx2("(\\w+(?:(?:-\\w+)*)?='[^']*')", QRegularExpression::UseUnicodePropertiesOption);
+    QRegularExpressionMatchIterator rx2MatchIterator = rx2.globalMatch(tmpprop.trimmed());
+    while (rx2MatchIterator.hasNext()) {
+        QRegularExpressionMatch match = rx2MatchIterator.next();
+        sl << match.captured();
+    }
+
+    foreach (QString s, sl) {
+#if QT_VERSION < QT_VERSION_CHECK(5,14,0)
+        QStringList sl2 = s.trimmed().split("=",QString::SkipEmptyParts);
+#else
+        QStringList sl2 = s.trimmed().split("=",Qt::SkipEmptyParts);
+#endif
+        QString v = sl2.at(1);
+        if (v.at(0) == v.at(v.length()-1) && (v.at(0) == '\'' || v.at(0) == '"'))
+            v = v.mid(1, v.length() - 2);
+        map[sl2.at(0).trimmed()] = v;
+    }
+
+    return map;
+}
+
+
+
+static QMap<QString, QString>
+legacyTrapProperties(const QString &msg)
+{
+    return legacyGetTagProperties(msg, "trap");
+}
+
+
+
+static QMap<QString, QString>
+trapProperties(const QString &msg)
+{
+    return SimpleXmlParser::getTagProperties(msg, "trap");
+}
+
+
+
+static SimpleXmlParser::AttributeList
+trapAttributes(const QString &msg)
+{
+    static const SimpleXmlParser::TagQuery trap("trap");
+    SimpleXmlParser::AttributeList attributes;
+    SimpleXmlParser::getTagAttributes(msg, trap, attributes);
+    return attributes;
+}
+
+
+
+void
+SimpleXmlParser::bench_getTagProperties()
+{
+    QString trap = "<TrapList><trap eventType='userInput' networkType='eth' isAlice='true'"
+                   " userName='mario.rossi@gmail.com' fwVersion='13.16.00' raVersion='01.11.00'"
+                   " loVersion='027.072.000' timestamp='2013/06/07_14:45:13'>"
+                   "<body eventName='PLAY' videoTitle='Il Gladiatore'/></trap></TrapList>";
+
+    Q_ASSERT(trapProperties(trap) == legacyTrapProperties(trap));
+    Q_ASSERT(trapAttributes(trap).size() == 8);
+
+    double before = measureThroughput(legacyTrapProperties, trap);
+    reportThroughput("getTagProperties, trap tag", before, measureThroughput(trapProperties, trap));
+    reportThroughput("getTagAttributes into an AttributeList, trap tag", before, measureThroughput(trapAttributes, trap));
+}
+
+
+
+/*
+ *  the TestIDs of a testplan the way it was done before select(): one getTagsValues() per level
+ */
+static QStringList
+chainedTestIds(const QString &msg)
+{
+    QStringList ids;
+    foreach (const QString &phaseList, SimpleXmlParser::getTagsValues(msg, "PhaseList"))
+        foreach (const QString &phase, SimpleXmlParser::getTagsValues(phaseList, "Phase"))
+            foreach (const QString &test, SimpleXmlParser::getTagsValues(phase, "Test"))
+                foreach (const QString &testList, SimpleXmlParser::getTagsValues(test, "TestList"))
+                    foreach (const QString &testData, SimpleXmlParser::getTagsValues(testList, "TestData"))
+                        ids << SimpleXmlParser::getTagsValues(testData, "TestID");
+    return ids;
+}
+
+
+
+static QVector<QStringView>
+selectedTestIds(const QString &msg)
+{
+    static const SimpleXmlParser::PathQuery path("PhaseList/Phase/Test/TestList/TestData/TestID");
+    return SimpleXmlParser::selectViews(msg, path);
+}
+
+
+
+void
+SimpleXmlParser::bench_select()
+{
+    QString plan = "<TestPlan><TestData/><TPID>76</TPID><PhaseList>";
+    for (int phase = 1; phase <= 20; phase++) {
+        plan += QString("<Phase phid=\"%1\"><Test><srcAgentId>1</srcAgentId><TestList>").arg(phase);
+        for (int test = 1; test <= 20; test++)
+            plan += QString("<TestData><TestID>%1</TestID><Duration>60</Duration><Param><ParamName/><ParamValue/></Param></TestData>").arg(test);
+        plan += "</TestList></Test></Phase>";
+    }
+    plan += "</PhaseList></TestPlan>";
+
+    Q_ASSERT(chainedTestIds(plan).size() == 400);
+    Q_ASSERT(selectedTestIds(plan).size() == 400);
+
+    reportThroughput("select, testplan TestIDs", measureThroughput(chainedTestIds, plan), measureThroughput(selectedTestIds, plan));
+}
+
+
+
+static const char *const testPlanFields[] = {
+    "TPID", "VlanId", "RepeatMode", "LastPhaseDelay", "srcAgentId", "dstAgentId",
+    "TestID", "Duration", "ParamName", "ParamValue", "Owner", "Priority"
+};
+static const int testPlanFieldCount = sizeof(testPlanFields) / sizeof(testPlanFields[0]);
+
+
+
+static QStringList
+testPlanFieldNames()
+{
+    QStringList names;
+    for (int i = 0; i < testPlanFieldCount; i++)
+        names << testPlanFields[i];
+    return names;
+}
+
+
+
+static QStringList
+fieldsOneByOne(const QString &msg)
+{
+    QStringList values;
+    for (int i = 0; i < testPlanFieldCount; i++)
+        values << SimpleXmlParser::getTagValue(msg, testPlanFields[i]);
+    return values;
+}
+
+
+
+static QVector<QStringView>
+fieldsWithTagSet(const QString &msg)
+{
+    static const SimpleXmlParser::TagSet fields(testPlanFieldNames());
+    return SimpleXmlParser::getTagSetValuesViews(msg, fields);
+}
+
+
+
+void
+SimpleXmlParser::bench_getTagSetValues()
+{
+    QString plan = "<TestPlan><TestData/><TPID>76</TPID><VlanId>1</VlanId><RepeatMode>0</RepeatMode>"
+                   "<LastPhaseDelay>0</LastPhaseDelay><Owner>noc</Owner><Priority>2</Priority><PhaseList>";
+    for (int phase = 1; phase <= 5; phase++) {
+        plan += QString("<Phase phid=\"%1\"><Test><srcAgentId>1</srcAgentId><dstAgentId>5</dstAgentId><TestList>").arg(phase);
+        for (int test = 1; test <= 10; test++)
+            plan += QString("<TestData><TestID>%1</TestID><Duration>60</Duration><Param><ParamName/><ParamValue/></Param></TestData>").arg(test);
+        plan += "</TestList></Test></Phase>";
+    }
+    plan += "</PhaseList></TestPlan>";
+
+    Q_ASSERT(fieldsWithTagSet(plan).size() == testPlanFieldCount);
+
+    reportThroughput("getTagSetValues, 12 testplan fields", measureThroughput(fieldsOneByOne, plan), measureThroughput(fieldsWithTagSet, plan));
+}
+
+
+
+/*
+ *  the message list as it was before the lock-free queue
+ */
+class LegacyMessageQueue
+{
+    QStringList m_messages;
+    QMutex m_mutex;
+
+public:
+    bool tryPush(QString &msg)
+    {
+        m_mutex.lock();
+            m_messages.append(msg);
+        m_mutex.unlock();
+        return true;
+    }
+
+    bool tryPop(QString &msg)
+    {
+        bool found = false;
+        m_mutex.lock();
+            if (!m_messages.isEmpty()) {
+                msg = m_messages.takeFirst();
+                found = true;
+            }
+        m_mutex.unlock();
+        return found;
+    }
+};
+
+
+
+/*!
+  \brief one thread pushes \a count copies of \a msg while \a consumers threads pop them
+  \return the number of messages per second passed through \a queue
+  */
+template <typename Queue>
+static double
+measureQueue(Queue &queue, int consumers, int count, const QString &msg)
+{
+    std::atomic<int> taken(0);
+    std::vector<std::thread> threads;
+    QElapsedTimer timer;
+    timer.start();
+    for (int c = 0; c < consumers; c++) {
+        threads.push_back(std::thread([&queue, &taken, count]() {
+            QString s;
+            while (taken.load(std::memory_order_relaxed) < count) {
+                if (queue.tryPop(s))
+                    taken++;
+                else
+                    QThread::yieldCurrentThread();
+            }
+        }));
+    }
+    for (int i = 0; i < count; i++) {
+        QString s(msg);
+        while (!queue.tryPush(s))
+            QThread::yieldCurrentThread();
+    }
+    for (size_t c = 0; c < threads.size(); c++)
+        threads[c].join();
+
+    return double(count) / timer.nsecsElapsed() * 1e9;
+}
+
+
+
+void
+SimpleXmlParser::bench_messageQueue()
+{
+    const int count = 200000;
+    QString msg = "<TestPlan><TPID>76</TPID></TestPlan>";
+
+    for (int consumers = 1; consumers <= 4; consumers *= 2) {
+        LegacyMessageQueue legacy;
+        SimpleXmlQueue<QString> queue(65536);
+        double before = measureQueue(legacy, consumers, count, msg);
+        double after = measureQueue(queue, consumers, count, msg);
+        qDebug() << "message queue, 1 producer" << consumers << "consumers : before" << before
+                 << "msg/s, after" << after << "msg/s, speedup" << after / before;
+    }
+}
+
+
+
+/*!
+  \brief feeds \a stream to \a feed in 1400 bytes chunks (a socket read) for at least 200ms
+  \return the throughput in MB/s of UTF-8 input
+  */
+template <typename Function>
+static double
+measureStream(Function feed, const QByteArray &stream)
+{
+    const int chunk = 1400;
+    QElapsedTimer timer;
+    qint64 iterations = 0;
+    timer.start();
+    do {
+        for (int i = 0; i < stream.size(); i += chunk)
+            feed(stream.mid(i, chunk));
+        iterations++;
+    } while (timer.elapsed() < 200);
+
+    return double(stream.size()) * iterations / timer.nsecsElapsed() * 1000.0;
+}
+
+
+
+void
+SimpleXmlParser::bench_addUtf8Data()
+{
+    QByteArray stream;
+    for (int i = 0; i < 2000; i++)
+        stream += QString("<event id=\"%1\"><type>userInput</type><name>PLAY</name><title>Il Gladiatore</title></event>").arg(i).toUtf8();
+
+    SimpleXmlParser textParser, utf8Parser;
+    textParser.setStartTag("event");
+    utf8Parser.setStartTag("event");
+    int taken = 0;
+
+    //the messages are forwarded as UTF-8, as a relay or a logger would do
+    double before = measureStream([&textParser, &taken](const QByteArray &chunk) {
+        textParser.addData(QString::fromUtf8(chunk));
+        while (textParser.hasPendingMessages())
+            taken += textParser.getNextMessage().toUtf8().size();
+    }, stream);
+    double after = measureStream([&utf8Parser, &taken](const QByteArray &chunk) {
+        utf8Parser.addUtf8Data(chunk);
+        while (utf8Parser.hasPendingMessages())
+            taken += utf8Parser.getNextMessageUtf8().size();
+    }, stream);
+    Q_UNUSED(taken);
+
+    reportThroughput("addData vs addUtf8Data, 2000 messages in 1400 bytes chunks", before, after);
+}
+
+
+
+/*
+ *  a handler for SimpleXmlCore that just counts the messages
+ */
+struct MessageCounter
+{
+    int messages;
+
+    void message(int, SimpleXmlCore16::View)                    { messages++;   }
+    void tag(int, SimpleXmlCore16::View)                        {}
+    void unmatchedEndTag()                                      {}
+};
+
+
+
+/*!
+  \brief creates \a count objects with \a create, keeping them all alive, then destroys them
+  \return the nanoseconds taken per object
+  */
+template <typename Object, typename Function>
+static double
+measureConstruction(int count, Function create)
+{
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<Object *> objects;
+    objects.reserve(count);
+    for (int i = 0; i < count; i++)
+        objects.push_back(create());
+    for (int i = 0; i < count; i++)
+        delete objects[i];
+    return double(timer.nsecsElapsed()) / count;
+}
+
+
+
+void
+SimpleXmlParser::bench_instanceFootprint()
+{
+    const int count = 20000;
+    std::u16string msg = u"<event><type>userInput</type></event>";
+
+    //a connection that received one message, the parser for it is set up as a server would do
+    double parserCost = measureConstruction<SimpleXmlParser>(count, [&msg]() {
+        SimpleXmlParser *parser = new SimpleXmlParser;
+        parser->setStartTag("event");
+        parser->addTagToFind("type");
+        parser->addData(QString(reinterpret_cast<const QChar *>(msg.data()), int(msg.size())));
+        parser->getNextMessage();
+        return parser;
+    });
+    double coreCost = measureConstruction<SimpleXmlCore16>(count, [&msg]() {
+        SimpleXmlCore16 *core = new SimpleXmlCore16;
+        core->setStartTag(u"event");
+        core->addTagToFind(u"type");
+        MessageCounter counter = { 0 };
+        core->feed(msg.data(), int(msg.size()), counter);
+        return core;
+    });
+
+    SimpleXmlParser parser;
+    qDebug() << "instance size: SimpleXmlParser" << sizeof(SimpleXmlParser) << "bytes, SimpleXmlCore16" << sizeof(SimpleXmlCore16)
+             << "bytes, plus the message queue ring allocated by the first message:" << parser.getQueueCapacity() * sizeof(Message) << "bytes";
+    qDebug() << "instance setup with one message : before" << parserCost << "ns, after" << coreCost << "ns, speedup" << parserCost / coreCost;
+}
+
+
+
+/*!
+  \brief rewinds \a device and runs \a read on it until it is all consumed, for at least 200ms
+  \return the throughput in MB/s of UTF-8 input
+  */
+template <typename Function>
+static double
+measureDevice(Function read, QIODevice &device)
+{
+    QElapsedTimer timer;
+    qint64 iterations = 0;
+    timer.start();
+    do {
+        device.seek(0);
+        read();
+        iterations++;
+    } while (timer.elapsed() < 200);
+
+    return double(device.size()) * iterations / timer.nsecsElapsed() * 1000.0;
+}
+
+
+
+void
+SimpleXmlParser::bench_attach()
+{
+    QByteArray stream;
+    for (int i = 0; i < 2000; i++)
+        stream += QString("<event id=\"%1\"><type>userInput</type><name>PLAY</name><title>Il Gladiatore</title></event>").arg(i).toUtf8();
+    QBuffer device(&stream);
+    device.open(QIODevice::ReadOnly);
+
+    SimpleXmlParser readParser, attachedParser;
+    readParser.setStartTag("event");
+    attachedParser.setStartTag("event");
+    attachedParser.attach(&device);
+    int taken = 0;
+
+    //the usual readyRead slot: a QByteArray per read, then copied into the parser
+    double before = measureDevice([&readParser, &device, &taken]() {
+        while (!device.atEnd()) {
+            readParser.addUtf8Data(device.read(16384));
+            taken += readParser.takeMessagesUtf8().size();
+        }
+    }, device);
+    double after = measureDevice([&attachedParser, &taken]() {
+        attachedParser.readDevice();
+        taken += attachedParser.takeMessagesUtf8().size();
+    }, device);
+    attachedParser.detach();
+    Q_UNUSED(taken);
+
+    reportThroughput("read() + addUtf8Data vs attach, 2000 messages in 16384 bytes reads", before, after);
+}
+
+
+
+void
+SimpleXmlParser::bench_parseFile()
+{
+    QTemporaryFile file;
+    file.open();
+    QByteArray block;
+    for (int i = 0; i < 1000; i++)
+        block += QString("<event id=\"%1\"><type>userInput</type><name>PLAY</name><title>Il Gladiatore</title></event>\n").arg(i).toUtf8();
+    for (int i = 0; i < 300; i++)
+        file.write(block);
+    file.close();
+    const double megabytes = double(block.size()) * 300 / 1e6;
+
+    //the messages are dispatched as QString, as the tester would use them
+    int taken = 0;
+    SimpleXmlParser loadParser, fileParser;
+    loadParser.setStartTag("event");
+    fileParser.setStartTag("event");
+    loadParser.setNotificationMode(E_DispatchMessageAndDelete);
+    fileParser.setNotificationMode(E_DispatchMessageAndDelete);
+    connect(&loadParser, &SimpleXmlParser::parsedMessage, [&taken](QString msg) { taken += msg.size(); });
+    connect(&fileParser, &SimpleXmlParser::parsedMessage, [&taken](QString msg) { taken += msg.size(); });
+
+    QElapsedTimer timer;
+    timer.start();
+    QFile f(file.fileName());
+    f.open(QIODevice::ReadOnly);
+    loadParser.addData(QString::fromUtf8(f.readAll()));
+    f.close();
+    double before = megabytes / timer.nsecsElapsed() * 1e9;
+
+    timer.start();
+    fileParser.parseFile(file.fileName());
+    double after = megabytes / timer.nsecsElapsed() * 1e9;
+    Q_UNUSED(taken);
+
+    reportThroughput("readAll + addData vs parseFile, 300000 messages in one file", before, after);
+}
+
+
+
+/*
+ *  what a consumer typically does with each message: its fields, decoded
+ */
+static QVariant
+extractFields(QStringView msg)
+{
+    QString text = msg.toString();
+    QStringList fields;
+    for (int i = 0; i < testPlanFieldCount; i++)
+        fields << SimpleXmlParser::getDecodedTagsValues(text, testPlanFields[i]);
+    return QVariant(fields);
+}
+
+
+
+void
+SimpleXmlParser::bench_pipeline()
+{
+    QString stream;
+    for (int i = 0; i < 300; i++) {
+        stream += QString("<TestPlan><TPID>%1</TPID><VlanId>1</VlanId><RepeatMode>0</RepeatMode><LastPhaseDelay>0</LastPhaseDelay>"
+                          "<Owner>noc &amp; ops</Owner><Priority>2</Priority><PhaseList>").arg(i);
+        for (int phase = 1; phase <= 2; phase++) {
+            stream += QString("<Phase phid=\"%1\"><Test><srcAgentId>1</srcAgentId><dstAgentId>5</dstAgentId><TestList>").arg(phase);
+            for (int test = 1; test <= 5; test++)
+                stream += QString("<TestData><TestID>%1</TestID><Duration>60</Duration><Param><ParamName>dscp</ParamName><ParamValue>&lt;46&gt;</ParamValue></Param></TestData>").arg(test);
+            stream += "</TestList></Test></Phase>";
+        }
+        stream += "</PhaseList></TestPlan>";
+    }
+
+    int taken = 0;
+    SimpleXmlParser inlineParser, pipelineParser;
+    inlineParser.setStartTag("TestPlan");
+    inlineParser.setNotificationMode(E_DispatchMessageAndDelete);
+    connect(&inlineParser, &SimpleXmlParser::parsedMessage, [&taken](QString msg) { taken += extractFields(msg).toStringList().size(); });
+    pipelineParser.setStartTag("TestPlan");
+    pipelineParser.setExtractionPipeline(extractFields);
+    connect(&pipelineParser, &SimpleXmlParser::messageExtracted, [&taken](QVariant result) { taken += result.toStringList().size(); });
+
+    double before = measureThroughput([&inlineParser](const QString &input) {
+        inlineParser.addData(input);
+        return input;
+    }, stream);
+    double after = measureThroughput([&pipelineParser](const QString &input) {
+        pipelineParser.addData(input);
+        pipelineParser.waitForExtraction();
+        return input;
+    }, stream);
+    Q_UNUSED(taken);
+
+    qDebug() << "extraction threads:" << pipelineParser.getExtractionThreads();
+    reportThroughput("extraction inline vs setExtractionPipeline, 300 testplans", before, after);
+}
+
+
+
+void
+SimpleXmlParser::bench_parallelScan()
+{
+    QString plan = "<TestPlan><TPID>76</TPID><PhaseList>";
+    for (int phase = 1; phase <= 2000; phase++) {
+        plan += QString("<Phase phid=\"%1\"><Test><srcAgentId>1</srcAgentId><dstAgentId>5</dstAgentId><TestList>").arg(phase);
+        for (int test = 1; test <= 20; test++)
+            plan += QString("<TestData><TestID>%1</TestID><Duration>60</Duration><Param><ParamName/><ParamValue/></Param></TestData>").arg(test);
+        plan += "</TestList></Test></Phase>";
+    }
+    plan += "</PhaseList></TestPlan>";
+
+    TagQuery query("TestID");
+    reportThroughput("getTagsValues vs getTagsValuesParallel, one 10 MB message",
+                     measureThroughput([&query](const QString &msg) { return getTagsValuesViews(msg, query); }, plan),
+                     measureThroughput([&query](const QString &msg) { return getTagsValuesViewsParallel(msg, query); }, plan));
+    reportThroughput("SimpleXmlIndex build vs buildParallel, one 10 MB message",
+                     measureThroughput([](const QString &msg) { SimpleXmlIndex index; index.build(msg); return QVector<int>(index.count()); }, plan),
+                     measureThroughput([](const QString &msg) { SimpleXmlIndex index; index.buildParallel(msg); return QVector<int>(index.count()); }, plan));
+    qDebug() << "parallel scan threads:" << parallelChunkCount(plan.size(), 0);
+}
+
+
+
+void
+SimpleXmlParser::bench_spill()
+{
+    //a 32 MB configuration dump streamed in 16384 bytes chunks, then a small message
+    QByteArray row = "<row><key>interface.eth0.mtu</key><value>1500</value></row>";
+    QByteArray chunk;
+    while (chunk.size() + row.size() <= 16384)
+        chunk += row;
+    const int chunks = 32 * 1024 * 1024 / chunk.size();
+
+    SimpleXmlParser buffered, spilled;
+    buffered.setStartTag("dump");
+    spilled.setStartTag("dump");
+    spilled.setSpillThreshold(1024 * 1024);
+    qint64 fileSize = 0;
+    connect(&spilled, &SimpleXmlParser::parsedMessageFile, [&fileSize](QSharedPointer<QFile> file) { fileSize = file->size(); });
+
+    SimpleXmlParser *parsers[] = { &buffered, &spilled };
+    int peak[2] = { 0, 0 };
+    qint64 nsecs[2] = { 0, 0 };
+    for (int p = 0; p < 2; p++) {
+        QElapsedTimer timer;
+        timer.start();
+        parsers[p]->addUtf8Data("<dump>");
+        for (int i = 0; i < chunks; i++) {
+            parsers[p]->addUtf8Data(chunk);
+            peak[p] = qMax(peak[p], parsers[p]->m_utf8Core.bufferSize());
+        }
+        parsers[p]->addUtf8Data("</dump><dump>small</dump>");
+        nsecs[p] = timer.nsecsElapsed();
+    }
+    int bufferedCount = buffered.takeMessagesUtf8().size();
+    int spilledCount = spilled.takeMessagesUtf8().size();
+    Q_ASSERT(bufferedCount == 2 && spilledCount == 1 && fileSize > qint64(chunks) * chunk.size());
+
+    qDebug() << "32 MB message buffered vs spilled : buffer peak before" << peak[0] / 1024 << "KB, after" << peak[1] / 1024 << "KB,"
+             << "throughput before" << double(chunks) * chunk.size() / nsecs[0] * 1000.0 << "MB/s, after"
+             << double(chunks) * chunk.size() / nsecs[1] * 1000.0 << "MB/s";
+}
+
+
+
+static const char *const testPlanNumbers[] = { "TPID", "VlanId", "RepeatMode", "LastPhaseDelay", "srcAgentId", "dstAgentId", "TestID", "Duration" };
+static const int testPlanNumberCount = sizeof(testPlanNumbers) / sizeof(testPlanNumbers[0]);
+
+
+
+/* the numeric fields of a testplan read the usual way, a QString for each value converted with toInt() */
+static QVector<int>
+numbersFromStrings(const QString &msg)
+{
+    QVector<int> numbers;
+    for (int i = 0; i < testPlanNumberCount; i++)
+        numbers << SimpleXmlParser::getTagValue(msg, testPlanNumbers[i]).toInt();
+    return numbers;
+}
+
+
+
+static QVector<int>
+numbersTyped(const QString &msg)
+{
+    static const QVector<SimpleXmlParser::TagQuery> tags = []() {
+        QVector<SimpleXmlParser::TagQuery> t;
+        for (int i = 0; i < testPlanNumberCount; i++)
+            t << SimpleXmlParser::TagQuery(testPlanNumbers[i]);
+        return t;
+    }();
+    QVector<int> numbers;
+    for (int i = 0; i < testPlanNumberCount; i++)
+        numbers << SimpleXmlParser::getTagValueAs<int>(msg, tags.at(i));
+    return numbers;
+}
+
+
+
+void
+SimpleXmlParser::bench_typedValues()
+{
+    QString plan = "<TestPlan><TestData/><TPID>76</TPID><VlanId>1</VlanId><RepeatMode>0</RepeatMode><LastPhaseDelay>0</LastPhaseDelay>"
+                   "<Phase phid=\"1\"><Test><srcAgentId>1</srcAgentId><dstAgentId>5</dstAgentId><TestList>"
+                   "<TestData><TestID>1</TestID><Duration>60</Duration></TestData></TestList></Test></Phase></TestPlan>";
+
+    Q_ASSERT(numbersFromStrings(plan) == numbersTyped(plan));
+
+    reportThroughput("getTagValue().toInt() vs getTagValueAs<int>, 8 testplan fields", measureThroughput(numbersFromStrings, plan), measureThroughput(numbersTyped, plan));
+}
+
+
+
+/* a testplan as its consumers model it */
+struct PlanParam
+{
+    QString name;
+    QString value;
+};
+SXML_BINDING(PlanParam,
+             SimpleXmlBind::tag("ParamName", &PlanParam::name),
+             SimpleXmlBind::tag("ParamValue", &PlanParam::value))
+
+struct PlanTestData
+{
+    int testId = 0;
+    int duration = 0;
+    QVector<PlanParam> params;
+};
+SXML_BINDING(PlanTestData,
+             SimpleXmlBind::tag("TestID", &PlanTestData::testId),
+             SimpleXmlBind::tag("Duration", &PlanTestData::duration),
+             SimpleXmlBind::list("Param", &PlanTestData::params))
+
+struct PlanTest
+{
+    int srcAgentId = 0;
+    int dstAgentId = 0;
+    QVector<PlanTestData> tests;
+};
+SXML_BINDING(PlanTest,
+             SimpleXmlBind::tag("srcAgentId", &PlanTest::srcAgentId),
+             SimpleXmlBind::tag("dstAgentId", &PlanTest::dstAgentId),
+             SimpleXmlBind::list("TestList", "TestData", &PlanTest::tests))
+
+struct PlanPhase
+{
+    int phid = 0;
+    PlanTest test;
+};
+SXML_BINDING(PlanPhase,
+             SimpleXmlBind::attribute("phid", &PlanPhase::phid),
+             SimpleXmlBind::tag("Test", &PlanPhase::test))
+
+struct Plan
+{
+    int tpid = 0;
+    int vlanId = 0;
+    QVector<PlanPhase> phases;
+};
+SXML_BINDING(Plan,
+             SimpleXmlBind::tag("TPID", &Plan::tpid),
+             SimpleXmlBind::tag("VlanId", &Plan::vlanId),
+             SimpleXmlBind::list("PhaseList", "Phase", &Plan::phases))
+
+
+
+/* the hand-written way: a getter per field, the nested lists cut out as strings and scanned again */
+static QVector<PlanPhase>
+planWithGetters(const QString &msg)
+{
+    Plan plan;
+    plan.tpid = SimpleXmlParser::getTagValue(msg, "TPID").toInt();
+    plan.vlanId = SimpleXmlParser::getTagValue(msg, "VlanId").toInt();
+    QList<QMap<QString, QString> > phaseAttributes = SimpleXmlParser::getTagsProperties(msg, "Phase");
+    QStringList phases = SimpleXmlParser::getTagsValues(msg, "Phase");
+    for (int i = 0; i < phases.size(); i++) {
+        PlanPhase phase;
+        phase.phid = phaseAttributes.value(i).value("phid").toInt();
+        phase.test.srcAgentId = SimpleXmlParser::getTagValue(phases.at(i), "srcAgentId").toInt();
+        phase.test.dstAgentId = SimpleXmlParser::getTagValue(phases.at(i), "dstAgentId").toInt();
+        foreach (const QString &test, SimpleXmlParser::getTagsValues(phases.at(i), "TestData")) {
+            PlanTestData data;
+            data.testId = SimpleXmlParser::getTagValue(test, "TestID").toInt();
+            data.duration = SimpleXmlParser::getTagValue(test, "Duration").toInt();
+            foreach (const QString &param, SimpleXmlParser::getTagsValues(test, "Param")) {
+                PlanParam p;
+                p.name = SimpleXmlParser::getDecodedTagValue(param, "ParamName");
+                p.value = SimpleXmlParser::getDecodedTagValue(param, "ParamValue");
+                data.params << p;
+            }
+            phase.test.tests << data;
+        }
+        plan.phases << phase;
+    }
+    return plan.phases;
+}
+
+
+
+static QVector<PlanPhase>
+planWithBinding(const QString &msg)
+{
+    Plan plan;
+    SimpleXmlBind::fill(msg, plan);
+    return plan.phases;
+}
+
+
+
+void
+SimpleXmlParser::bench_bind()
+{
+    QString plan = "<TestPlan><TestData/><TPID>76</TPID><VlanId>1</VlanId><RepeatMode>0</RepeatMode><PhaseList>";
+    for (int phase = 1; phase <= 5; phase++) {
+        plan += QString("<Phase phid=\"%1\"><Test><srcAgentId>1</srcAgentId><dstAgentId>5</dstAgentId><TestList>").arg(phase);
+        for (int test = 1; test <= 10; test++)
+            plan += QString("<TestData><TestID>%1</TestID><Duration>60</Duration><Param><ParamName>rate</ParamName><ParamValue>10</ParamValue></Param></TestData>").arg(test);
+        plan += "</TestList></Test></Phase>";
+    }
+    plan += "</PhaseList></TestPlan>";
+
+    QVector<PlanPhase> expected = planWithGetters(plan), bound = planWithBinding(plan);
+    Q_ASSERT(bound.size() == 5 && expected.size() == 5);
+    Q_ASSERT(bound.at(4).phid == 5 && bound.at(4).test.tests.size() == 10);
+    Q_ASSERT(bound.at(4).test.tests.at(9).testId == expected.at(4).test.tests.at(9).testId);
+    Q_ASSERT(bound.at(4).test.tests.at(9).params.at(0).value == expected.at(4).test.tests.at(9).params.at(0).value);
+    Q_UNUSED(expected);
+    Q_UNUSED(bound);
+
+    reportThroughput("getTagValue chain vs SimpleXmlBind::fill, testplan of 5 phases x 10 tests", measureThroughput(planWithGetters, plan), measureThroughput(planWithBinding, plan));
+}
@@ -1,5 +1,4 @@
 #include <QCoreApplication>
-#include <QFile>
 #include <QDebug>
 
 #include <nrparamparser.h>
@@ -9,17 +8,13 @@
 int main(int argc, char** argv) {
 
     NRParamParser pp = NRParamParser::instance();
+    pp.acceptParam("b", "bench", false);
     pp.parse(argc,argv);
     QCoreApplication app(argc,argv);
     SimpleXmlParser xml;
 
-    QFile f("testplan_76.xml");
-    f.open(QIODevice::ReadOnly);
-    QString tp = f.readAll();
-    f.close();
-
     xml.setStartTag("TestPlan");
-    xml.addData(tp);
+    xml.parseFile("testplan_76.xml");
 
     QString s = xml.getNextMessage();
     QStringList sl = xml.getTagsValues(s,"TestData");
@@ -31,6 +26,36 @@ int main(int argc, char** argv) {
     SimpleXmlParser::test_getTag();
     SimpleXmlParser::test_getProperty();
     SimpleXmlParser::test_addData();
+    SimpleXmlParser::test_index();
+    SimpleXmlParser::test_scan();
+    SimpleXmlParser::test_core();
+    SimpleXmlParser::test_attach();
+    SimpleXmlParser::test_parseFile();
+    SimpleXmlParser::test_pipeline();
+    SimpleXmlParser::test_parallelScan();
+    SimpleXmlParser::test_startTags();
+    SimpleXmlParser::test_resync();
+    SimpleXmlParser::test_spill();
+    SimpleXmlParser::test_typedValues();
+    SimpleXmlParser::test_bind();
+
+    if (pp.isSet("bench")) {
+        SimpleXmlParser::bench_decodeEntities();
+        SimpleXmlParser::bench_encodeEntities();
+        SimpleXmlParser::bench_getTagProperties();
+        SimpleXmlParser::bench_select();
+        SimpleXmlParser::bench_getTagSetValues();
+        SimpleXmlParser::bench_messageQueue();
+        SimpleXmlParser::bench_addUtf8Data();
+        SimpleXmlParser::bench_instanceFootprint();
+        SimpleXmlParser::bench_attach();
+        SimpleXmlParser::bench_parseFile();
+        SimpleXmlParser::bench_pipeline();
+        SimpleXmlParser::bench_parallelScan();
+        SimpleXmlParser::bench_spill();
+        SimpleXmlParser::bench_typedValues();
+        SimpleXmlParser::bench_bind();
+    }
 
 return app.exec();
 }
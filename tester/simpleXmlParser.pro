@@ -1,15 +1,24 @@
+QT += network
 
-CONFIG += debug debug_and_release
+CONFIG += debug debug_and_release c++17
 TARGET = xmlparsetest
 DEPENDPATH += . paramparser_class ../simplexmlparser_class
 INCLUDEPATH += . paramparser_class ../simplexmlparser_class
 
 # Input
 HEADERS += paramparser_class/nrparamparser.h \
-           ../simplexmlparser_class/SimpleXmlParser.h
+           ../simplexmlparser_class/SimpleXmlParser.h \
+           ../simplexmlparser_class/SimpleXmlBind.h \
+           ../simplexmlparser_class/SimpleXmlIndex.h \
+           ../simplexmlparser_class/SimpleXmlScan.h \
+           ../simplexmlparser_class/SimpleXmlCore.h \
+           ../simplexmlparser_class/SimpleXmlQueue.h \
+           ../simplexmlparser_class/SimpleXmlPipeline.h
 SOURCES += main.cpp \
+           SimpleXmlParserBench.cpp \
            paramparser_class/nrparamparser.cpp \
-           ../simplexmlparser_class/SimpleXmlParser.cpp
+           ../simplexmlparser_class/SimpleXmlParser.cpp \
+           ../simplexmlparser_class/SimpleXmlIndex.cpp
 
 unix {
 TEMPLATE = app